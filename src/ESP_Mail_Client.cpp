@@ -125,7 +125,7 @@ void ESP_Mail_Client::debugInfoP(PGM_P info)
 
 char *ESP_Mail_Client::getRandomUID()
 {
-  char *tmp = (char *)newP(36);
+  char *tmp = (char *)newP(36, esp_mail_alloc_type_integer);
   itoa(random(10000000, 20000000), tmp, 10);
   return tmp;
 }
@@ -158,85 +158,184 @@ void ESP_Mail_Client::strcat_c(char *str, char c)
 
 int ESP_Mail_Client::strpos(const char *haystack, const char *needle, int offset, bool caseSensitive)
 {
-  if (!haystack || !needle)
+  if (!haystack || !needle || !needle[0] || offset < 0)
     return -1;
 
-  int hlen = strlen(haystack);
-  int nlen = strlen(needle);
-
-  if (hlen == 0 || nlen == 0)
+  //the offset past the end of haystack is not searched
+  if (offset > 0 && memchr(haystack, 0, offset))
     return -1;
 
-  int hidx = offset, nidx = 0;
-  while ((*(haystack + hidx) != '\0') && (*(needle + nidx) != '\0') && hidx < hlen)
+  const char *p = haystack + offset;
+
+  if (caseSensitive)
+    p = strstr(p, needle);
+  else
   {
-    bool nm = caseSensitive ? *(needle + nidx) != *(haystack + hidx) : tolower(*(needle + nidx)) != tolower(*(haystack + hidx));
+    //find the first needle character in either case then compare the rest
+    char lc = tolower((unsigned char)needle[0]);
+    char uc = toupper((unsigned char)needle[0]);
+    const char *rest = needle + 1;
+    size_t restLen = strlen(rest);
 
-    if (nm)
-    {
-      hidx++;
-      nidx = 0;
-    }
-    else
+    while (p)
     {
-      nidx++;
-      hidx++;
-      if (nidx == nlen)
-        return hidx - nidx;
+      if (lc == uc)
+        p = strchr(p, lc);
+      else
+      {
+        while (*p && *p != lc && *p != uc)
+          p++;
+        if (!*p)
+          p = nullptr;
+      }
+
+      if (!p || strncasecmp(p + 1, rest, restLen) == 0)
+        break;
+      p++;
     }
   }
 
-  return -1;
+  return p ? p - haystack : -1;
 }
 
-int ESP_Mail_Client::readLine(WiFiClient *stream, char *buf, int bufLen, bool crlf, int &count)
+bool ESP_Mail_Client::fillReader(WiFiClient *stream, struct esp_mail_line_reader_t &reader)
 {
-  int ret = -1;
-  char c = 0;
-  char _c = 0;
-  int idx = 0;
   if (!stream)
+    return false;
+
+  if (!reader.buf)
+  {
+    reader.buf = (uint8_t *)newP(ESP_MAIL_CLIENT_READ_BUFFER_SIZE);
+    if (!reader.buf)
+      return false;
+  }
+
+  //move the unread data to the front
+  if (reader.pos > 0)
+  {
+    reader.len -= reader.pos;
+    if (reader.len > 0)
+      memmove(reader.buf, reader.buf + reader.pos, reader.len);
+    reader.pos = 0;
+  }
+
+  int sz = stream->available();
+  if (sz > (int)(ESP_MAIL_CLIENT_READ_BUFFER_SIZE - reader.len))
+    sz = ESP_MAIL_CLIENT_READ_BUFFER_SIZE - reader.len;
+
+  if (sz <= 0)
+    return false;
+
+  int len = stream->read(reader.buf + reader.len, sz);
+  if (len <= 0)
+    return false;
+
+  reader.len += len;
+  return true;
+}
+
+void ESP_Mail_Client::clearReader(struct esp_mail_line_reader_t &reader)
+{
+  delP(&reader.buf);
+  reader.len = 0;
+  reader.pos = 0;
+}
+
+int ESP_Mail_Client::readerAvailable(WiFiClient *stream, struct esp_mail_line_reader_t &reader)
+{
+  int sz = reader.len - reader.pos;
+  if (stream)
+    sz += stream->available();
+  return sz;
+}
+
+int ESP_Mail_Client::readByte(WiFiClient *stream, struct esp_mail_line_reader_t &reader)
+{
+  if (reader.pos == reader.len && !fillReader(stream, reader))
+    return -1;
+  return reader.buf[reader.pos++];
+}
+
+int ESP_Mail_Client::readBytes(WiFiClient *stream, struct esp_mail_line_reader_t &reader, char *buf, int len)
+{
+  int idx = 0;
+  while (idx < len)
+  {
+    if (reader.pos == reader.len && !fillReader(stream, reader))
+      break;
+
+    int n = reader.len - reader.pos;
+    if (n > len - idx)
+      n = len - idx;
+    memcpy(buf + idx, reader.buf + reader.pos, n);
+    reader.pos += n;
+    idx += n;
+  }
+  return idx;
+}
+
+int ESP_Mail_Client::readLine(WiFiClient *stream, struct esp_mail_line_reader_t &reader, char *buf, int bufLen, bool crlf, int &count)
+{
+  int idx = 0;
+  if (!stream || bufLen < 1)
     return idx;
-  while (stream->available() && idx < bufLen)
+
+  while (idx < bufLen - 1)
   {
-    ret = stream->read();
-    if (ret > -1)
-    {
-      if (idx >= bufLen - 1)
-        return idx;
+    if (reader.pos == reader.len && !fillReader(stream, reader))
+      break;
 
-      c = (char)ret;
-      strcat_c(buf, c);
-      idx++;
-      count++;
-      if (_c == '\r' && c == '\n')
+    uint8_t *data = reader.buf + reader.pos;
+    size_t n = reader.len - reader.pos;
+    if (n > (size_t)(bufLen - 1 - idx))
+      n = bufLen - 1 - idx;
+
+    //find the CRLF, the CR may be the last byte copied from the previous block
+    size_t lineLen = n;
+    bool eol = false;
+    uint8_t *lf = (uint8_t *)memchr(data, '\n', n);
+    while (lf)
+    {
+      size_t ofs = lf - data;
+      if ((ofs > 0 && data[ofs - 1] == '\r') || (ofs == 0 && idx > 0 && buf[idx - 1] == '\r'))
       {
-        if (!crlf)
-        {
-          buf[idx - 2] = 0;
-          idx -= 2;
-        }
-        return idx;
+        lineLen = ofs + 1;
+        eol = true;
+        break;
       }
-      _c = c;
+      lf = (uint8_t *)memchr(lf + 1, '\n', n - ofs - 1);
+    }
+
+    memcpy(buf + idx, data, lineLen);
+    reader.pos += lineLen;
+    idx += lineLen;
+    count += lineLen;
+
+    if (eol)
+    {
+      if (!crlf)
+        idx -= 2;
+      break;
     }
-    if (!stream)
-      return idx;
   }
+
+  buf[idx] = 0;
   return idx;
 }
 
 char *ESP_Mail_Client::subStr(const char *buf, PGM_P beginH, PGM_P endH, int beginPos, int endPos, bool caseSensitive)
 {
   char *tmp = nullptr;
-  int p1 = strposP(buf, beginH, beginPos, caseSensitive);
+  esp_mail_flash_str_t begin(beginH);
+  int p1 = strpos(buf, begin.str, beginPos, caseSensitive);
   if (p1 != -1)
   {
+    size_t bufLen = strlen(buf);
 
-    while (buf[p1 + strlen_P(beginH)] == ' ' || buf[p1 + strlen_P(beginH)] == '\r' || buf[p1 + strlen_P(beginH)] == '\n')
+    while (buf[p1 + begin.len] == ' ' || buf[p1 + begin.len] == '\r' || buf[p1 + begin.len] == '\n')
     {
       p1++;
-      if (strlen(buf) <= p1 + strlen_P(beginH))
+      if (bufLen <= p1 + begin.len)
       {
         p1--;
         break;
@@ -245,14 +344,14 @@ char *ESP_Mail_Client::subStr(const char *buf, PGM_P beginH, PGM_P endH, int beg
 
     int p2 = -1;
     if (endPos == 0)
-      p2 = strposP(buf, endH, p1 + strlen_P(beginH), caseSensitive);
+      p2 = strposP(buf, endH, p1 + begin.len, caseSensitive);
 
     if (p2 == -1)
-      p2 = strlen(buf);
+      p2 = bufLen;
 
-    int len = p2 - p1 - strlen_P(beginH);
-    tmp = (char *)newP(len + 1);
-    memcpy(tmp, &buf[p1 + strlen_P(beginH)], len);
+    int len = p2 - p1 - begin.len;
+    tmp = (char *)newP(len + 1, esp_mail_alloc_type_substring);
+    memcpy(tmp, &buf[p1 + begin.len], len);
     return tmp;
   }
 
@@ -383,7 +482,19 @@ void ESP_Mail_Client::delP(void *ptr)
   void **p = (void **)ptr;
   if (*p)
   {
+    if (arenaDelP(*p))
+    {
+      *p = 0;
+      return;
+    }
+
+#if defined(ENABLE_ALLOC_STATS)
+    uint8_t *h = (uint8_t *)*p - ESP_MAIL_ALLOC_HEADER_SIZE;
+    countFree(*(size_t *)h);
+    free(h);
+#else
     free(*p);
+#endif
     *p = 0;
   }
 }
@@ -400,24 +511,165 @@ size_t ESP_Mail_Client::getReservedLen(size_t len)
   return (size_t)newlen;
 }
 
-void *ESP_Mail_Client::newP(size_t len)
+void *ESP_Mail_Client::newP(size_t len, esp_mail_alloc_type type)
 {
   void *p;
+
+  //the short-lived strings are taken from the arena while it has room
+  if (type != esp_mail_alloc_type_buffer && (p = arenaNewP(len)) != nullptr)
+    return p;
+
+  size_t size = getReservedLen(len);
+
+#if defined(ENABLE_ALLOC_STATS)
+  size += ESP_MAIL_ALLOC_HEADER_SIZE;
+#endif
+
 #if defined(BOARD_HAS_PSRAM) && defined(ESP_MAIL_USE_PSRAM)
 
-  if ((p = (void *)ps_malloc(getReservedLen(len))) == 0)
+  if ((p = (void *)ps_malloc(size)) == 0)
     return NULL;
 
 #else
 
-  if ((p = (void *)malloc(getReservedLen(len))) == 0)
+  if ((p = (void *)malloc(size)) == 0)
     return NULL;
 
 #endif
+
+#if defined(ENABLE_ALLOC_STATS)
+  //keep the allocated size in front of the buffer for delP
+  *(size_t *)p = size;
+  p = (uint8_t *)p + ESP_MAIL_ALLOC_HEADER_SIZE;
+  countAlloc(size, type);
+#endif
+
   memset(p, 0, len);
   return p;
 }
 
+#if defined(ENABLE_ALLOC_STATS)
+void ESP_Mail_Client::countAlloc(size_t size, esp_mail_alloc_type type)
+{
+  _allocStats.count++;
+  _allocStats.bytes += size;
+  _allocStats.liveBytes += size;
+  if (_allocStats.liveBytes > _allocStats.peakBytes)
+    _allocStats.peakBytes = _allocStats.liveBytes;
+  _allocStats.typeCount[type]++;
+}
+
+void ESP_Mail_Client::countFree(size_t size)
+{
+  _allocStats.freeCount++;
+  if (_allocStats.liveBytes >= size)
+    _allocStats.liveBytes -= size;
+  else
+    _allocStats.liveBytes = 0;
+}
+
+esp_mail_alloc_stats_t ESP_Mail_Client::allocStats()
+{
+  return _lastAllocStats;
+}
+#endif
+
+void *ESP_Mail_Client::arenaNewP(size_t len)
+{
+  if (len == 0)
+    return nullptr;
+
+#if defined(ESP32)
+  portENTER_CRITICAL(&_arena.mux);
+#endif
+
+  size_t ofs = (_arena.used + sizeof(size_t) - 1) & ~(sizeof(size_t) - 1);
+  bool fit = ofs + len <= sizeof(_arena.buf);
+  if (fit)
+  {
+    _arena.last = ofs;
+    _arena.used = ofs + len;
+    _arena.live++;
+  }
+
+#if defined(ESP32)
+  portEXIT_CRITICAL(&_arena.mux);
+#endif
+
+  if (!fit)
+    return nullptr;
+
+  memset(_arena.buf + ofs, 0, len);
+  return _arena.buf + ofs;
+}
+
+bool ESP_Mail_Client::arenaDelP(void *ptr)
+{
+  char *p = (char *)ptr;
+  if (p < _arena.buf || p >= _arena.buf + sizeof(_arena.buf))
+    return false;
+
+#if defined(ESP32)
+  portENTER_CRITICAL(&_arena.mux);
+#endif
+
+  //only the most recent string gives its space back, the others wait until all are freed
+  if (--_arena.live == 0)
+  {
+    _arena.used = 0;
+    _arena.last = sizeof(_arena.buf);
+  }
+  else if (p == _arena.buf + _arena.last)
+  {
+    _arena.used = _arena.last;
+    _arena.last = sizeof(_arena.buf);
+  }
+
+#if defined(ESP32)
+  portEXIT_CRITICAL(&_arena.mux);
+#endif
+
+  return true;
+}
+
+void ESP_Mail_Client::beginAllocStats()
+{
+#if defined(ENABLE_ALLOC_STATS)
+  if (_allocStatsLevel++ > 0)
+    return;
+  size_t liveBytes = _allocStats.liveBytes;
+  _allocStats = esp_mail_alloc_stats_t();
+  _allocStats.liveBytes = liveBytes;
+  _allocStats.peakBytes = liveBytes;
+#endif
+}
+
+void ESP_Mail_Client::endAllocStats(bool debug)
+{
+#if defined(ENABLE_ALLOC_STATS)
+  if (_allocStatsLevel > 0 && --_allocStatsLevel > 0)
+    return;
+
+  _lastAllocStats = _allocStats;
+
+  if (!debug)
+    return;
+
+  PGM_P labels[8] = {esp_mail_str_343, esp_mail_str_344, esp_mail_str_345, esp_mail_str_346, esp_mail_str_350, esp_mail_str_347, esp_mail_str_348, esp_mail_str_349};
+  size_t values[8] = {_lastAllocStats.count, _lastAllocStats.freeCount, _lastAllocStats.bytes, _lastAllocStats.peakBytes, _lastAllocStats.typeCount[esp_mail_alloc_type_buffer], _lastAllocStats.typeCount[esp_mail_alloc_type_flash_string], _lastAllocStats.typeCount[esp_mail_alloc_type_integer], _lastAllocStats.typeCount[esp_mail_alloc_type_substring]};
+
+  MBSTRING s;
+  for (int i = 0; i < 8; i++)
+  {
+    appendP(s, labels[i], false);
+    appendInt(s, values[i]);
+  }
+  esp_mail_debug(s.c_str());
+#else
+  (void)debug;
+#endif
+}
+
 char *ESP_Mail_Client::newS(char *p, size_t len)
 {
   delP(&p);
@@ -435,36 +687,27 @@ char *ESP_Mail_Client::newS(char *p, size_t len, char *d)
 
 bool ESP_Mail_Client::strcmpP(const char *buf, int ofs, PGM_P beginH, bool caseSensitive)
 {
-  char *tmp = nullptr;
+  esp_mail_flash_str_t s(beginH);
   if (ofs < 0)
   {
-    int p = strposP(buf, beginH, 0, caseSensitive);
+    int p = strpos(buf, s.str, 0, caseSensitive);
     if (p == -1)
       return false;
     ofs = p;
   }
-  tmp = strP(beginH);
-  char *tmp2 = (char *)newP(strlen_P(beginH) + 1);
-  memcpy(tmp2, &buf[ofs], strlen_P(beginH));
-  tmp2[strlen_P(beginH)] = 0;
-  bool ret = (strcasecmp(tmp, tmp2) == 0);
-  delP(&tmp);
-  delP(&tmp2);
-  return ret;
+  return strncasecmp(buf + ofs, s.str, s.len) == 0;
 }
 
 int ESP_Mail_Client::strposP(const char *buf, PGM_P beginH, int ofs, bool caseSensitive)
 {
-  char *tmp = strP(beginH);
-  int p = strpos(buf, tmp, ofs, caseSensitive);
-  delP(&tmp);
-  return p;
+  esp_mail_flash_str_t s(beginH);
+  return strpos(buf, s.str, ofs, caseSensitive);
 }
 
 char *ESP_Mail_Client::strP(PGM_P pgm)
 {
   size_t len = strlen_P(pgm) + 1;
-  char *buf = (char *)newP(len);
+  char *buf = (char *)newP(len, esp_mail_alloc_type_flash_string);
   strcpy_P(buf, pgm);
   buf[len - 1] = 0;
   return buf;
@@ -474,17 +717,41 @@ void ESP_Mail_Client::appendP(MBSTRING &buf, PGM_P p, bool empty)
 {
   if (empty)
     buf.clear();
-  char *b = strP(p);
-  buf += b;
-  delP(&b);
+  esp_mail_flash_str_t s(p);
+  buf.append(s.str, s.len);
 }
 
-char *ESP_Mail_Client::intStr(int value)
+size_t ESP_Mail_Client::intToStr(int value, char *buf)
 {
-  char *buf = (char *)newP(36);
-  memset(buf, 0, 36);
-  itoa(value, buf, 10);
-  return buf;
+  //the digits are written from the lowest then reversed, buf holds at least 12 bytes
+  uint32_t v = value < 0 ? 0 - (uint32_t)value : (uint32_t)value;
+  size_t len = 0;
+
+  do
+  {
+    buf[len++] = '0' + v % 10;
+    v /= 10;
+  } while (v > 0);
+
+  if (value < 0)
+    buf[len++] = '-';
+
+  for (size_t i = 0; i < len / 2; i++)
+  {
+    char c = buf[i];
+    buf[i] = buf[len - 1 - i];
+    buf[len - 1 - i] = c;
+  }
+
+  buf[len] = 0;
+  return len;
+}
+
+void ESP_Mail_Client::appendInt(MBSTRING &buf, int value)
+{
+  char tmp[12];
+  size_t len = intToStr(value, tmp);
+  buf.append(tmp, len);
 }
 
 char *ESP_Mail_Client::strReplace(char *orig, char *rep, char *with)
@@ -519,12 +786,9 @@ char *ESP_Mail_Client::strReplace(char *orig, char *rep, char *with)
 
 char *ESP_Mail_Client::strReplaceP(char *buf, PGM_P name, PGM_P value)
 {
-  char *n = strP(name);
-  char *v = strP(value);
-  char *out = strReplace(buf, n, v);
-  delP(&n);
-  delP(&v);
-  return out;
+  esp_mail_flash_str_t n(name);
+  esp_mail_flash_str_t v(value);
+  return strReplace(buf, (char *)n.str, (char *)v.str);
 }
 
 bool ESP_Mail_Client::authFailed(char *buf, int bufLen, int &chunkIdx, int ofs)
@@ -546,80 +810,95 @@ bool ESP_Mail_Client::authFailed(char *buf, int bufLen, int &chunkIdx, int ofs)
 
 unsigned char *ESP_Mail_Client::decodeBase64(const unsigned char *src, size_t len, size_t *out_len)
 {
-  unsigned char *out, *pos, block[4], tmp;
-  size_t i, count, olen;
-  int pad = 0;
-  size_t extra_pad;
-
-  unsigned char *dtable = (unsigned char *)newP(256);
+  struct esp_mail_base64_decoder_t decoder;
 
-  memset(dtable, 0x80, 256);
+  unsigned char *out = (unsigned char *)newP((len + 3) / 4 * 3 + 1);
+  if (!out)
+    return nullptr;
 
-  for (i = 0; i < sizeof(b64_index_table) - 1; i++)
-    dtable[b64_index_table[i]] = (unsigned char)i;
-  dtable['='] = 0;
+  size_t olen = decodeBase64Chunk(decoder, src, len, out);
+  olen += decodeBase64End(decoder, out + olen);
 
-  count = 0;
-  for (i = 0; i < len; i++)
+  if (olen == 0)
   {
-    if (dtable[src[i]] != 0x80)
-      count++;
+    delP(&out);
+    return nullptr;
   }
 
-  if (count == 0)
-    goto exit;
-  extra_pad = (4 - count % 4) % 4;
+  *out_len = olen;
+  return out;
+}
 
-  olen = (count + extra_pad) / 4 * 3;
-  pos = out = (unsigned char *)malloc(olen);
-  if (out == NULL)
-    goto exit;
+size_t ESP_Mail_Client::decodeBase64Chunk(struct esp_mail_base64_decoder_t &decoder, const unsigned char *src, size_t len, unsigned char *out)
+{
+  unsigned char *pos = out;
+  size_t i = 0;
 
-  count = 0;
-  for (i = 0; i < len + extra_pad; i++)
+  while (i < len && !decoder.done)
   {
-    unsigned char val;
+    //decode the whole quantum at once when it is aligned and has no padding or skipped characters
+    if (decoder.count == 0 && i + 4 <= len)
+    {
+      unsigned char a = b64_decode_table[src[i]];
+      unsigned char b = b64_decode_table[src[i + 1]];
+      unsigned char c = b64_decode_table[src[i + 2]];
+      unsigned char d = b64_decode_table[src[i + 3]];
+      if (((a | b | c | d) & 0xc0) == 0)
+      {
+        *pos++ = (a << 2) | (b >> 4);
+        *pos++ = (b << 4) | (c >> 2);
+        *pos++ = (c << 6) | d;
+        i += 4;
+        continue;
+      }
+    }
 
-    if (i >= len)
-      val = '=';
-    else
-      val = src[i];
-    tmp = dtable[val];
-    if (tmp == 0x80)
+    unsigned char val = b64_decode_table[src[i++]];
+    if (val & 0x80)
       continue;
 
-    if (val == '=')
-      pad++;
-    block[count] = tmp;
-    count++;
-    if (count == 4)
+    if (val == 0x40)
     {
-      *pos++ = (block[0] << 2) | (block[1] >> 4);
-      *pos++ = (block[1] << 4) | (block[2] >> 2);
-      *pos++ = (block[2] << 6) | block[3];
-      count = 0;
-      if (pad)
+      decoder.pad++;
+      val = 0;
+    }
+
+    decoder.quad[decoder.count++] = val;
+
+    if (decoder.count == 4)
+    {
+      *pos++ = (decoder.quad[0] << 2) | (decoder.quad[1] >> 4);
+      *pos++ = (decoder.quad[1] << 4) | (decoder.quad[2] >> 2);
+      *pos++ = (decoder.quad[2] << 6) | decoder.quad[3];
+      decoder.count = 0;
+      if (decoder.pad)
       {
-        if (pad == 1)
-          pos--;
-        else if (pad == 2)
-          pos -= 2;
-        else
-        {
-          free(out);
-          goto exit;
-        }
-        break;
+        //the padded quantum is the last one, drop it when it has less than two sextets
+        pos -= decoder.pad < 3 ? decoder.pad : 3;
+        decoder.done = true;
       }
     }
   }
 
-  *out_len = pos - out;
-  delP(&dtable);
-  return out;
-exit:
-  delP(&dtable);
-  return nullptr;
+  return pos - out;
+}
+
+size_t ESP_Mail_Client::decodeBase64End(struct esp_mail_base64_decoder_t &decoder, unsigned char *out)
+{
+  size_t olen = 0;
+  int sextets = decoder.count - decoder.pad;
+
+  //decode the incomplete quantum as if it was padded
+  if (!decoder.done && sextets > 1)
+  {
+    out[olen++] = (decoder.quad[0] << 2) | (decoder.quad[1] >> 4);
+    if (sextets == 3)
+      out[olen++] = (decoder.quad[1] << 4) | (decoder.quad[2] >> 2);
+  }
+
+  decoder = esp_mail_base64_decoder_t();
+
+  return olen;
 }
 
 MBSTRING ESP_Mail_Client::encodeBase64Str(const unsigned char *src, size_t len)
@@ -630,45 +909,69 @@ MBSTRING ESP_Mail_Client::encodeBase64Str(const unsigned char *src, size_t len)
 MBSTRING ESP_Mail_Client::encodeBase64Str(uint8_t *src, size_t len)
 {
   MBSTRING outStr;
-  unsigned char *out, *pos;
-  const unsigned char *end, *in;
   size_t olen = 4 * ((len + 2) / 3);
   if (olen < len)
     return outStr;
 
   outStr.resize(olen);
-  out = (unsigned char *)&outStr[0];
 
-  end = src + len;
-  in = src;
-  pos = out;
+  int col = 0;
+  encodeBase64Lines(src, len, (unsigned char *)&outStr[0], col, true, 0);
+
+  return outStr;
+}
+
+size_t ESP_Mail_Client::encodeBase64Lines(const unsigned char *src, size_t len, unsigned char *out, int &col, bool last, int lineLen)
+{
+  unsigned char *pos = out;
+  const unsigned char *end = src + len;
 
-  while (end - in >= 3)
+  while (end - src >= 3)
   {
-    *pos++ = b64_index_table[in[0] >> 2];
-    *pos++ = b64_index_table[((in[0] & 0x03) << 4) | (in[1] >> 4)];
-    *pos++ = b64_index_table[((in[1] & 0x0f) << 2) | (in[2] >> 6)];
-    *pos++ = b64_index_table[in[2] & 0x3f];
-    in += 3;
+    //encode the rest of the line without checking the line length for each quantum
+    size_t n = (end - src) / 3;
+    if (lineLen > 0 && n > (size_t)(lineLen - col) / 4)
+      n = (lineLen - col) / 4;
+
+    for (size_t i = 0; i < n; i++)
+    {
+      uint32_t v = ((uint32_t)src[0] << 16) | ((uint32_t)src[1] << 8) | src[2];
+      pos[0] = b64_index_table[v >> 18];
+      pos[1] = b64_index_table[(v >> 12) & 0x3f];
+      pos[2] = b64_index_table[(v >> 6) & 0x3f];
+      pos[3] = b64_index_table[v & 0x3f];
+      src += 3;
+      pos += 4;
+    }
+
+    col += n * 4;
+
+    if (lineLen > 0 && col + 4 > lineLen)
+    {
+      *pos++ = 0x0d;
+      *pos++ = 0x0a;
+      col = 0;
+    }
   }
 
-  if (end - in)
+  if (last && end - src > 0)
   {
-    *pos++ = b64_index_table[in[0] >> 2];
-    if (end - in == 1)
+    *pos++ = b64_index_table[src[0] >> 2];
+    if (end - src == 1)
     {
-      *pos++ = b64_index_table[(in[0] & 0x03) << 4];
+      *pos++ = b64_index_table[(src[0] & 0x03) << 4];
       *pos++ = '=';
     }
     else
     {
-      *pos++ = b64_index_table[((in[0] & 0x03) << 4) | (in[1] >> 4)];
-      *pos++ = b64_index_table[(in[1] & 0x0f) << 2];
+      *pos++ = b64_index_table[((src[0] & 0x03) << 4) | (src[1] >> 4)];
+      *pos++ = b64_index_table[(src[1] & 0x0f) << 2];
     }
     *pos++ = '=';
+    col += 4;
   }
 
-  return outStr;
+  return pos - out;
 }
 
 void ESP_Mail_Client::createDirs(MBSTRING dirs)
@@ -735,33 +1038,82 @@ bool ESP_Mail_Client::sdTest()
 
 #if defined(ENABLE_IMAP)
 
-int ESP_Mail_Client::decodeChar(const char *s)
+int ESP_Mail_Client::hexDigit(char c)
 {
-  return 16 * hexval(*(s + 1)) + hexval(*(s + 2));
+  if (c >= '0' && c <= '9')
+    return c - '0';
+  if (c >= 'A' && c <= 'F')
+    return c - 'A' + 10;
+  if (c >= 'a' && c <= 'f')
+    return c - 'a' + 10;
+  return -1;
 }
 
-void ESP_Mail_Client::decodeQP(const char *buf, char *out)
+size_t ESP_Mail_Client::decodeQP(struct esp_mail_qp_decoder_t &decoder, const char *src, size_t len, char *out)
 {
-  char *tmp = strP(esp_mail_str_295);
-  while (*buf)
+  char *pos = out;
+  size_t i = 0;
+
+  //the output is at most two bytes longer than the input when the pending characters are not an escape
+  while (i < len)
   {
-    if (*buf != '=')
-      strcat_c(out, *buf++);
-    else if (*(buf + 1) == '\r' && *(buf + 2) == '\n')
-      buf += 3;
-    else if (*(buf + 1) == '\n')
-      buf += 2;
-    else if (!strchr(tmp, *(buf + 1)))
-      strcat_c(out, *buf++);
-    else if (!strchr(tmp, *(buf + 2)))
-      strcat_c(out, *buf++);
+    char c = src[i];
+
+    if (decoder.count == 0)
+    {
+      if (c == '=')
+      {
+        decoder.pending[0] = c;
+        decoder.count = 1;
+      }
+      else
+        *pos++ = c;
+      i++;
+    }
+    else if (decoder.count == 1)
+    {
+      if (c == '\n')
+      {
+        //soft line break
+        decoder.count = 0;
+        i++;
+      }
+      else if (c == '\r' || hexDigit(c) > -1)
+      {
+        decoder.pending[1] = c;
+        decoder.count = 2;
+        i++;
+      }
+      else
+      {
+        *pos++ = '=';
+        decoder.count = 0;
+      }
+    }
     else
     {
-      strcat_c(out, decodeChar(buf));
-      buf += 3;
+      if (decoder.pending[1] == '\r' && c == '\n')
+      {
+        //soft line break
+        decoder.count = 0;
+        i++;
+      }
+      else if (decoder.pending[1] != '\r' && hexDigit(c) > -1)
+      {
+        *pos++ = (hexDigit(decoder.pending[1]) << 4) | hexDigit(c);
+        decoder.count = 0;
+        i++;
+      }
+      else
+      {
+        *pos++ = '=';
+        *pos++ = decoder.pending[1];
+        decoder.count = 0;
+      }
     }
   }
-  delP(&tmp);
+
+  return pos - out;
 }
 
 char *ESP_Mail_Client::decode7Bit(char *buf)
@@ -843,117 +1195,239 @@ char *ESP_Mail_Client::decode7Bit(char *buf)
 
 void ESP_Mail_Client::decodeHeader(MBSTRING &headerField)
 {
+  esp_mail_flash_str_t begin(esp_mail_str_359);
+  esp_mail_flash_str_t end(esp_mail_str_360);
+
+  const char *s = headerField.c_str();
 
-  size_t p1 = 0, p2 = 0;
-  MBSTRING headerEnc;
+  if (!strstr(s, begin.str))
+    return;
 
-  while (headerField[p1] == ' ' && p1 < headerField.length() - 1)
-    p1++;
+  MBSTRING out;
+  bool encoded = false;
 
-  if (headerField[p1] == '=' && headerField[p1 + 1] == '?')
+  while (*s)
   {
-    p2 = headerField.find("?", p1 + 2);
-    if (p2 != MBSTRING::npos)
-      headerEnc = headerField.substr(p1 + 2, p2 - p1 - 2);
-  }
+    //the encoded word, =?charset?encoding?text?=
+    const char *p = strstr(s, begin.str);
+    const char *q = p ? strchr(p + 2, '?') : nullptr;
+    const char *e = q && q[1] && q[2] == '?' ? strstr(q + 3, end.str) : nullptr;
 
-  int bufSize = 512;
-  char *buf = (char *)newP(bufSize);
+    if (!e)
+    {
+      out += s;
+      break;
+    }
 
-  RFC2047Decoder.rfc2047Decode(buf, headerField.c_str(), bufSize);
+    //the white space between the encoded words is ignored
+    size_t n = p - s;
+    if (n > 0 && (!encoded || strspn(s, " \t\r\n") != n))
+      out.append(s, n);
 
-  if (getEncodingFromCharset(headerEnc.c_str()) == esp_mail_char_decoding_scheme_iso8859_1)
-  {
-    int len = strlen(buf);
-    int olen = (len + 1) * 2;
-    unsigned char *out = (unsigned char *)newP(olen);
-    decodeLatin1_UTF8(out, &olen, (unsigned char *)buf, &len);
-    delP(&buf);
-    buf = (char *)out;
-  }
-  else if (getEncodingFromCharset(headerEnc.c_str()) == esp_mail_char_decoding_scheme_tis620)
-  {
-    size_t len2 = strlen(buf);
-    char *tmp = (char *)newP((len2 + 1) * 3);
-    decodeTIS620_UTF8(tmp, buf, len2);
-    delP(&buf);
-    buf = tmp;
+    decodeHeaderWord(out, p + 2, q[1], q + 3, e - q - 3);
+    encoded = true;
+    s = e + 2;
   }
 
-  headerField = buf;
-  delP(&buf);
+  headerField = out;
 }
 
-esp_mail_char_decoding_scheme ESP_Mail_Client::getEncodingFromCharset(const char *enc)
+void ESP_Mail_Client::decodeHeaderFields(struct esp_mail_imap_rfc822_msg_header_item_t &fields)
 {
-  esp_mail_char_decoding_scheme scheme = esp_mail_char_decoding_scheme_default;
+  esp_mail_flash_str_t begin(esp_mail_str_359);
+
+  //the flags are not the header text
+  for (int i = 0; i < esp_mail_rfc822_header_field_flags; i++)
+  {
+    esp_mail_rfc822_header_field_types field = (esp_mail_rfc822_header_field_types)i;
+    if (!strstr(fields.get(field), begin.str))
+      continue;
 
-  if (strposP(enc, esp_mail_str_237, 0) > -1 || strposP(enc, esp_mail_str_231, 0) > -1 || strposP(enc, esp_mail_str_226, 0) > -1)
-    scheme = esp_mail_char_decoding_scheme_tis620;
-  else if (strposP(enc, esp_mail_str_227, 0) > -1)
-    scheme = esp_mail_char_decoding_scheme_iso8859_1;
+    MBSTRING s = fields.get(field);
+    decodeHeader(s);
+    fields.set(field, s.c_str());
+  }
 
-  return scheme;
+  fields.compact();
 }
 
-void ESP_Mail_Client::decodeTIS620_UTF8(char *out, const char *in, size_t len)
+const char *ESP_Mail_Client::internStr(IMAPSession *imap, const char *str)
 {
-  //output is the 3-byte value UTF-8
-  int j = 0;
-  for (size_t i = 0; i < len; i++)
+  if (!str || strlen(str) == 0)
+    return "";
+
+  for (size_t i = 0; i < imap->_internStr.size(); i++)
+  {
+    if (strcmp(imap->_internStr[i], str) == 0)
+      return imap->_internStr[i];
+  }
+
+  char *p = (char *)newP(strlen(str) + 1);
+  if (!p)
+    return "";
+
+  strcpy(p, str);
+  imap->_internStr.push_back(p);
+  return p;
+}
+
+void ESP_Mail_Client::clearInternStr(IMAPSession *imap)
+{
+  for (size_t i = 0; i < imap->_internStr.size(); i++)
+    delP(&imap->_internStr[i]);
+  std::vector<char *>().swap(imap->_internStr);
+}
+
+void ESP_Mail_Client::decodeHeaderWord(MBSTRING &out, const char *charsetName, char enc, const char *text, size_t len)
+{
+  const struct esp_mail_charset_t *charset = getCharset(charsetName);
+
+  //the text of the unknown charset other than UTF-8 has its non-printable characters replaced
+  bool filter = !charset && !strcmpP(charsetName, 0, esp_mail_str_358, false);
+
+  char buf[64];
+  size_t blen = 0;
+
+  if (enc == 'B' || enc == 'b')
   {
-    if (in[i] < 0x80)
-      out[j++] = in[i];
-    else if ((in[i] >= 0xa0 && in[i] < 0xdb) || (in[i] > 0xde && in[i] < 0xfc))
+    struct esp_mail_base64_decoder_t decoder;
+    size_t pieceLen = (sizeof(buf) / 3 - 1) * 4;
+
+    for (size_t ofs = 0; ofs < len; ofs += pieceLen)
     {
-      int unicode = 0x0e00 + in[i] - 0xa0;
-      out[j++] = 0xe0 | ((unicode >> 12) & 0xf);
-      out[j++] = 0x80 | ((unicode >> 6) & 0x3f);
-      out[j++] = 0x80 | (unicode & 0x3f);
+      size_t n = len - ofs < pieceLen ? len - ofs : pieceLen;
+      blen = decodeBase64Chunk(decoder, (const unsigned char *)text + ofs, n, (unsigned char *)buf);
+      appendHeaderText(out, charset, filter, buf, blen);
     }
+
+    blen = decodeBase64End(decoder, (unsigned char *)buf);
+    appendHeaderText(out, charset, filter, buf, blen);
+  }
+  else if (enc == 'Q' || enc == 'q')
+  {
+    for (size_t i = 0; i < len; i++)
+    {
+      char c = text[i];
+      if (c == '_')
+        c = ' ';
+      else if (c == '=' && i + 2 < len && hexDigit(text[i + 1]) > -1 && hexDigit(text[i + 2]) > -1)
+      {
+        c = (hexDigit(text[i + 1]) << 4) | hexDigit(text[i + 2]);
+        i += 2;
+      }
+
+      buf[blen++] = c;
+      if (blen == sizeof(buf))
+      {
+        appendHeaderText(out, charset, filter, buf, blen);
+        blen = 0;
+      }
+    }
+
+    appendHeaderText(out, charset, filter, buf, blen);
   }
 }
 
-int ESP_Mail_Client::decodeLatin1_UTF8(unsigned char *out, int *outlen, const unsigned char *in, int *inlen)
+void ESP_Mail_Client::appendHeaderText(MBSTRING &out, const struct esp_mail_charset_t *charset, bool filter, char *text, size_t len)
 {
-  unsigned char *outstart = out;
-  const unsigned char *base = in;
-  const unsigned char *processed = in;
-  unsigned char *outend = out + *outlen;
-  const unsigned char *inend;
-  unsigned int c;
-  int bits;
+  if (len == 0)
+    return;
 
-  inend = in + (*inlen);
-  while ((in < inend) && (out - outstart + 5 < *outlen))
+  if (charset)
   {
-    c = *in++;
+    //a byte takes at most 3 bytes in UTF-8
+    char tmp[64 * 3];
+    out.append(tmp, decodeCharset(charset, text, len, tmp));
+    return;
+  }
 
-    /* assertion: c is a single UTF-4 value */
-    if (out >= outend)
-      break;
-    if (c < 0x80)
+  for (size_t i = 0; filter && i < len; i++)
+  {
+    unsigned char c = text[i];
+    if (c < 0x20 || c == 0x7f || (c >= 0x80 && c < 0xa0))
+      text[i] = '?';
+  }
+
+  out.append(text, len);
+}
+
+const struct esp_mail_charset_t *ESP_Mail_Client::getCharset(const char *enc)
+{
+  size_t len = strlen(enc);
+
+  //the name may be followed by the other parameters
+  for (size_t i = 0; i < sizeof(esp_mail_charsets) / sizeof(esp_mail_charsets[0]); i++)
+  {
+    size_t n = strlen_P(esp_mail_charsets[i].name);
+    if (len >= n && strcmpP(enc, 0, esp_mail_charsets[i].name, false) && !isalnum((unsigned char)enc[n]) && enc[n] != '-' && enc[n] != '_')
+      return &esp_mail_charsets[i];
+  }
+
+  return nullptr;
+}
+
+esp_mail_header_field ESP_Mail_Client::getHeaderField(const char *buf, size_t &valueOfs)
+{
+  //the field name is hashed while its end is found
+  uint32_t hash = 0;
+  size_t len = 0;
+  while (buf[len] && buf[len] != ':')
+  {
+    if (buf[len] == ' ' || buf[len] == '\t' || buf[len] == '\r' || buf[len] == '\n')
+      return esp_mail_header_field_unknown;
+    hash = hash * 187 + tolower((unsigned char)buf[len]);
+    len++;
+  }
+
+  if (buf[len] != ':' || len == 0)
+    return esp_mail_header_field_unknown;
+
+  esp_mail_header_field field = (esp_mail_header_field)pgm_read_byte(&esp_mail_header_field_slots[(hash >> 3) & 31]);
+  if (field == esp_mail_header_field_unknown)
+    return esp_mail_header_field_unknown;
+
+  esp_mail_flash_str_t name(esp_mail_header_field_names[field - 1]);
+  if (name.len != len + 1 || strncasecmp(buf, name.str, len) != 0)
+    return esp_mail_header_field_unknown;
+
+  valueOfs = name.len;
+  while (buf[valueOfs] == ' ' || buf[valueOfs] == '\r' || buf[valueOfs] == '\n')
+    valueOfs++;
+
+  return field;
+}
+
+size_t ESP_Mail_Client::decodeCharset(const struct esp_mail_charset_t *charset, const char *src, size_t len, char *out)
+{
+  char *pos = out;
+
+  for (size_t i = 0; i < len; i++)
+  {
+    uint16_t c = (unsigned char)src[i];
+
+    if (c >= 0x80 && charset->table)
     {
-      *out++ = c;
-      bits = -6;
+      c = pgm_read_word(charset->table + c - 0x80);
+      if (c == 0)
+        continue;
     }
-    else
+
+    if (c < 0x80)
+      *pos++ = c;
+    else if (c < 0x800)
     {
-      *out++ = ((c >> 6) & 0x1F) | 0xC0;
-      bits = 0;
+      *pos++ = 0xc0 | (c >> 6);
+      *pos++ = 0x80 | (c & 0x3f);
     }
-
-    for (; bits >= 0; bits -= 6)
+    else
     {
-      if (out >= outend)
-        break;
-      *out++ = ((c >> bits) & 0x3F) | 0x80;
+      *pos++ = 0xe0 | (c >> 12);
+      *pos++ = 0x80 | ((c >> 6) & 0x3f);
+      *pos++ = 0x80 | (c & 0x3f);
     }
-    processed = (const unsigned char *)in;
   }
-  *outlen = out - outstart;
-  *inlen = processed - base;
-  return (0);
+
+  return pos - out;
 }
 
 bool ESP_Mail_Client::sendIMAPCommand(IMAPSession *imap, int msgIndex, int cmdCase)
@@ -965,9 +1439,7 @@ bool ESP_Mail_Client::sendIMAPCommand(IMAPSession *imap, int msgIndex, int cmdCa
   else
     appendP(cmd, esp_mail_str_143, true);
 
-  char *tmp = intStr(imap->_msgUID[msgIndex]);
-  cmd += tmp;
-  delP(&tmp);
+  appendInt(cmd, imap->_msgUID[msgIndex]);
   appendP(cmd, esp_mail_str_147, false);
   if (!imap->_config->fetch.set_seen)
   {
@@ -1008,6 +1480,14 @@ bool ESP_Mail_Client::sendIMAPCommand(IMAPSession *imap, int msgIndex, int cmdCa
 }
 
 bool ESP_Mail_Client::readMail(IMAPSession *imap, bool closeSession)
+{
+  beginAllocStats();
+  bool ret = mReadMail(imap, closeSession);
+  endAllocStats(imap->_debug);
+  return ret;
+}
+
+bool ESP_Mail_Client::mReadMail(IMAPSession *imap, bool closeSession)
 {
 
   imap->checkUID();
@@ -1020,7 +1500,6 @@ bool ESP_Mail_Client::readMail(IMAPSession *imap, bool closeSession)
   MBSTRING command;
   MBSTRING _uid;
   appendP(command, esp_mail_str_27, true);
-  char *tmp = nullptr;
   size_t readCount = 0;
   imap->_multipart_levels.clear();
 
@@ -1055,6 +1534,7 @@ bool ESP_Mail_Client::readMail(IMAPSession *imap, bool closeSession)
     for (size_t i = 0; i < imap->_headers.size(); i++)
       imap->_headers[i].part_headers.clear();
     imap->_headers.clear();
+    clearInternStr(imap);
 
     if (strlen(imap->_config->fetch.uid) > 0)
       imap->_headerOnly = false;
@@ -1105,29 +1585,20 @@ bool ESP_Mail_Client::readMail(IMAPSession *imap, bool closeSession)
 
         if (imap->_config->search.criteria[i] == ' ')
         {
-          tmp = strP(esp_mail_str_140);
-          char *tmp2 = strP(esp_mail_str_224);
-
-          if ((imap->_uidSearch && strcmp(buf.c_str(), tmp) == 0) || (imap->_unseen && buf.find(tmp2) != MBSTRING::npos))
+          if ((imap->_uidSearch && strcmp_P(buf.c_str(), esp_mail_str_140) == 0) || (imap->_unseen && strposP(buf.c_str(), esp_mail_str_224, 0) != -1))
             buf.clear();
-          delP(&tmp);
-          delP(&tmp2);
 
-          tmp = strP(esp_mail_str_141);
-          if (strcmp(buf.c_str(), tmp) != 0 && buf.length() > 0)
+          if (strcmp_P(buf.c_str(), esp_mail_str_141) != 0 && buf.length() > 0)
           {
             appendP(command, esp_mail_str_131, false);
             command += buf;
           }
-          delP(&tmp);
           buf.clear();
         }
       }
 
-      tmp = strP(esp_mail_str_223);
-      if (imap->_unseen && strpos(imap->_config->search.criteria, tmp, 0) == -1)
+      if (imap->_unseen && strposP(imap->_config->search.criteria, esp_mail_str_223, 0) == -1)
         appendP(command, esp_mail_str_223, false);
-      delP(&tmp);
 
       if (buf.length() > 0)
       {
@@ -1150,25 +1621,19 @@ bool ESP_Mail_Client::readMail(IMAPSession *imap, bool closeSession)
         MBSTRING s;
         appendP(s, esp_mail_str_34, true);
         appendP(s, esp_mail_str_68, false);
-        char *tmp = intStr(imap->_config->limit.search);
-        s += tmp;
-        delP(&tmp);
+        appendInt(s, imap->_config->limit.search);
         imapCB(imap, s.c_str(), false);
 
         if (imap->_msgUID.size() > 0)
         {
 
           appendP(s, esp_mail_str_69, true);
-          tmp = intStr(imap->_mbif._searchCount);
-          s += tmp;
-          delP(&tmp);
+          appendInt(s, imap->_mbif._searchCount);
           appendP(s, esp_mail_str_70, false);
           imapCB(imap, s.c_str(), false);
 
           appendP(s, esp_mail_str_71, true);
-          tmp = intStr(imap->_msgUID.size());
-          s += tmp;
-          delP(&tmp);
+          appendInt(s, imap->_msgUID.size());
           appendP(s, esp_mail_str_70, false);
           imapCB(imap, s.c_str(), false);
         }
@@ -1185,9 +1650,8 @@ bool ESP_Mail_Client::readMail(IMAPSession *imap, bool closeSession)
       int uid = imap->getUID(imap->_mbif._msgCount);
       imap->_msgUID.push_back(uid);
       imap->_headerOnly = false;
-      char *tmp = intStr(uid);
-      _uid = tmp;
-      delP(&tmp);
+      _uid.clear();
+      appendInt(_uid, uid);
       imap->_config->fetch.uid = _uid.c_str();
     }
   }
@@ -1215,18 +1679,14 @@ bool ESP_Mail_Client::readMail(IMAPSession *imap, bool closeSession)
 
       MBSTRING s;
       appendP(s, esp_mail_str_74, true);
-      char *tmp = intStr(imap->_totalRead);
-      s += tmp;
-      delP(&tmp);
+      appendInt(s, imap->_totalRead);
 
       if (imap->_uidSearch || strlen(imap->_config->fetch.uid) > 0)
         appendP(s, esp_mail_str_75, false);
       else
         appendP(s, esp_mail_str_76, false);
 
-      tmp = intStr(imap->_msgUID[i]);
-      s += tmp;
-      delP(&tmp);
+      appendInt(s, imap->_msgUID[i]);
       imapCB(imap, "", false);
       imapCB(imap, s.c_str(), false);
     }
@@ -1243,9 +1703,7 @@ bool ESP_Mail_Client::readMail(IMAPSession *imap, bool closeSession)
     if (imap->_debug)
       debugInfoP(esp_mail_str_77);
 
-    char *tmp = intStr(imap->_msgUID[i]);
-    cmd += tmp;
-    delP(&tmp);
+    appendInt(cmd, imap->_msgUID[i]);
 
     appendP(cmd, esp_mail_str_147, false);
     if (!imap->_config->fetch.set_seen)
@@ -1269,7 +1727,7 @@ bool ESP_Mail_Client::readMail(IMAPSession *imap, bool closeSession)
     if (!handleIMAPResponse(imap, err, closeSession))
       return false;
 
-    cHeader(imap)->flags = imap->getFlags(cHeader(imap)->message_no);
+    cHeader(imap)->flags = internStr(imap, imap->getFlags(cHeader(imap)->message_no));
 
     if (!imap->_headerOnly)
     {
@@ -1338,9 +1796,7 @@ bool ESP_Mail_Client::readMail(IMAPSession *imap, bool closeSession)
           appendP(s, esp_mail_str_34, true);
           appendP(s, esp_mail_str_78, false);
 
-          char *tmp = intStr(cHeader(imap)->attachment_count);
-          s += tmp;
-          delP(&tmp);
+          appendInt(s, cHeader(imap)->attachment_count);
           appendP(s, esp_mail_str_79, false);
           imapCB(imap, s.c_str(), false);
 
@@ -1539,9 +1995,7 @@ bool ESP_Mail_Client::readMail(IMAPSession *imap, bool closeSession)
       MBSTRING s;
       appendP(s, esp_mail_str_261, true);
       appendP(s, esp_mail_str_84, false);
-      char *tmp = intStr(MailClient.getFreeHeap());
-      s += tmp;
-      delP(&tmp);
+      appendInt(s, MailClient.getFreeHeap());
       esp_mail_debug(s.c_str());
     }
   }
@@ -1590,9 +2044,7 @@ bool ESP_Mail_Client::getMultipartFechCmd(IMAPSession *imap, int msgIdx, MBSTRIN
   else
     appendP(partText, esp_mail_str_143, true);
 
-  char *tmp = intStr(imap->_msgUID[msgIdx]);
-  partText += tmp;
-  delP(&tmp);
+  appendInt(partText, imap->_msgUID[msgIdx]);
 
   appendP(partText, esp_mail_str_147, false);
   if (!imap->_config->fetch.set_seen)
@@ -1610,10 +2062,10 @@ bool ESP_Mail_Client::getMultipartFechCmd(IMAPSession *imap, int msgIdx, MBSTRIN
       appendP(cHeader(imap)->partNumStr, esp_mail_str_152, false);
     }
 
-    tmp = intStr(imap->_multipart_levels[i].level);
-    partText += tmp;
-    cHeader(imap)->partNumStr += tmp;
-    delP(&tmp);
+    char level[12];
+    size_t len = intToStr(imap->_multipart_levels[i].level, level);
+    partText.append(level, len);
+    cHeader(imap)->partNumStr.append(level, len);
   }
 
   if (imap->_multipart_levels[cLevel].fetch_rfc822_header)
@@ -1819,11 +2271,9 @@ bool ESP_Mail_Client::imapAuth(IMAPSession *imap)
     appendP(s, esp_mail_str_211, false);
     s += imap->_sesson_cfg->server.host_name;
     esp_mail_debug(s.c_str());
-    char *tmp = intStr(imap->_sesson_cfg->server.port);
     appendP(s, esp_mail_str_261, true);
     appendP(s, esp_mail_str_201, false);
-    s += tmp;
-    delP(&tmp);
+    appendInt(s, imap->_sesson_cfg->server.port);
     esp_mail_debug(s.c_str());
   }
 
@@ -1831,6 +2281,8 @@ bool ESP_Mail_Client::imapAuth(IMAPSession *imap)
 
   ethDNSWorkAround(imap->_sesson_cfg);
 
+  clearReader(imap->_reader);
+
   if (!imap->tcpClient.connect(secureMode, imap->_sesson_cfg->certificate.verify))
     return handleIMAPError(imap, IMAP_STATUS_SERVER_CONNECT_FAILED, false);
 
@@ -1885,6 +2337,8 @@ init:
 
     //connect in secure mode
     //do ssl handshake
+    //discard any plain text data buffered before the handshake
+    clearReader(imap->_reader);
 #if defined(ARDUINO_ARCH_SAMD)
     if (!imap->tcpClient.connectSSL(imap->_sesson_cfg->certificate.verify))
       return handleIMAPError(imap, MAIL_CLIENT_ERROR_SSL_TLS_STRUCTURE_SETUP, false);
@@ -2097,6 +2551,8 @@ size_t ESP_Mail_Client::imapSendP(IMAPSession *imap, PGM_P v, bool newline)
     len = 0;
   }
 
+  imap->_sentBytes += len;
+
   delP(&tmp);
 
   return len;
@@ -2142,6 +2598,8 @@ size_t ESP_Mail_Client::imapSend(IMAPSession *imap, const char *data, bool newli
     errorStatusCB(imap, MAIL_CLIENT_ERROR_SERVER_CONNECTION_FAILED);
     len = 0;
   }
+
+  imap->_sentBytes += len;
   return len;
 }
 
@@ -2165,7 +2623,8 @@ size_t ESP_Mail_Client::imapSend(IMAPSession *imap, int data, bool newline)
     return 0;
   }
 
-  char *tmp = intStr(data);
+  char tmp[12];
+  size_t tmpLen = intToStr(data, tmp);
   size_t len = 0;
 
   if (newline)
@@ -2181,30 +2640,39 @@ size_t ESP_Mail_Client::imapSend(IMAPSession *imap, int data, bool newline)
     len = imap->tcpClient.stream()->print(tmp);
   }
 
-  if (len != strlen(tmp) && len != strlen(tmp) + 2)
+  if (len != tmpLen && len != tmpLen + 2)
   {
     errorStatusCB(imap, MAIL_CLIENT_ERROR_SERVER_CONNECTION_FAILED);
     len = 0;
   }
 
-  delP(&tmp);
+  imap->_sentBytes += len;
 
   return len;
 }
 
 bool ESP_Mail_Client::setFlag(IMAPSession *imap, int msgUID, const char *flag, bool closeSession)
 {
-  return mSetFlag(imap, msgUID, flag, 0, closeSession);
+  beginAllocStats();
+  bool ret = mSetFlag(imap, msgUID, flag, 0, closeSession);
+  endAllocStats(imap->_debug);
+  return ret;
 }
 
 bool ESP_Mail_Client::addFlag(IMAPSession *imap, int msgUID, const char *flag, bool closeSession)
 {
-  return mSetFlag(imap, msgUID, flag, 1, closeSession);
+  beginAllocStats();
+  bool ret = mSetFlag(imap, msgUID, flag, 1, closeSession);
+  endAllocStats(imap->_debug);
+  return ret;
 }
 
 bool ESP_Mail_Client::removeFlag(IMAPSession *imap, int msgUID, const char *flag, bool closeSession)
 {
-  return mSetFlag(imap, msgUID, flag, 2, closeSession);
+  beginAllocStats();
+  bool ret = mSetFlag(imap, msgUID, flag, 2, closeSession);
+  endAllocStats(imap->_debug);
+  return ret;
 }
 
 bool ESP_Mail_Client::mSetFlag(IMAPSession *imap, int msgUID, const char *flag, uint8_t action, bool closeSession)
@@ -2263,9 +2731,7 @@ bool ESP_Mail_Client::mSetFlag(IMAPSession *imap, int msgUID, const char *flag,
 
   MBSTRING cmd;
   appendP(cmd, esp_mail_str_249, true);
-  char *tmp = intStr(msgUID);
-  cmd += tmp;
-  delP(&tmp);
+  appendInt(cmd, msgUID);
   if (action == 0)
     appendP(cmd, esp_mail_str_250, false);
   else if (action == 1)
@@ -2315,10 +2781,11 @@ int ESP_Mail_Client::getMSGNUM(IMAPSession *imap, char *buf, int bufLen, int &ch
   {
     delay(0);
 
-    ret = imap->tcpClient.stream()->read();
+    ret = readByte(imap->tcpClient.stream(), imap->_reader);
 
     if (ret > -1)
     {
+      imap->_readBytes++;
 
       if (idx >= bufLen - 1)
         return idx;
@@ -2389,8 +2856,11 @@ end_search:
 
   endSearch = true;
   int read = available(imap);
+  if (read > bufLen - 1 - idx)
+    read = bufLen - 1 - idx;
 
-  idx = imap->tcpClient.stream()->readBytes(buf + idx, read);
+  idx = readBytes(imap->tcpClient.stream(), imap->_reader, buf + idx, read);
+  imap->_readBytes += idx;
 
   return idx;
 }
@@ -2433,118 +2903,54 @@ void ESP_Mail_Client::handleHeader(IMAPSession *imap, char *buf, int bufLen, int
     if (octetCount > header.header_data_len + 2)
       return;
 
-    if (strcmpP(buf, 0, esp_mail_str_10, caseSensitive))
+    size_t ofs = 0;
+    switch (getHeaderField(buf, ofs))
     {
+    case esp_mail_header_field_from:
       headerState = esp_mail_imap_header_state::esp_mail_imap_state_from;
-      tmp = subStr(buf, esp_mail_str_10, NULL, 0, -1, caseSensitive);
-      if (tmp)
-      {
-        setHeader(imap, tmp, header, headerState);
-        delP(&tmp);
-      }
-    }
-    else if (strcmpP(buf, 0, esp_mail_str_150, caseSensitive))
-    {
+      setHeader(imap, buf + ofs, header, headerState);
+      break;
+    case esp_mail_header_field_sender:
       headerState = esp_mail_imap_header_state::esp_mail_imap_state_sender;
-      tmp = subStr(buf, esp_mail_str_150, NULL, 0, -1, caseSensitive);
-      if (tmp)
-      {
-        setHeader(imap, tmp, header, headerState);
-        delP(&tmp);
-      }
-    }
-    else if (strcmpP(buf, 0, esp_mail_str_11, caseSensitive))
-    {
+      setHeader(imap, buf + ofs, header, headerState);
+      break;
+    case esp_mail_header_field_to:
       headerState = esp_mail_imap_header_state::esp_mail_imap_state_to;
-      tmp = subStr(buf, esp_mail_str_11, NULL, 0, -1, caseSensitive);
-      if (tmp)
-      {
-        setHeader(imap, tmp, header, headerState);
-        delP(&tmp);
-      }
-    }
-    else if (strcmpP(buf, 0, esp_mail_str_12, caseSensitive))
-    {
+      setHeader(imap, buf + ofs, header, headerState);
+      break;
+    case esp_mail_header_field_cc:
       headerState = esp_mail_imap_header_state::esp_mail_imap_state_cc;
-      tmp = subStr(buf, esp_mail_str_12, NULL, 0, -1, caseSensitive);
-      if (tmp)
-      {
-        setHeader(imap, tmp, header, headerState);
-        delP(&tmp);
-      }
-    }
-    else if (strcmpP(buf, 0, esp_mail_str_24, caseSensitive))
-    {
+      setHeader(imap, buf + ofs, header, headerState);
+      break;
+    case esp_mail_header_field_subject:
       headerState = esp_mail_imap_header_state::esp_mail_imap_state_subject;
-      tmp = subStr(buf, esp_mail_str_24, NULL, 0, -1, caseSensitive);
-      if (tmp)
-      {
-        setHeader(imap, tmp, header, headerState);
-        delP(&tmp);
-      }
-    }
-    else if (strcmpP(buf, 0, esp_mail_str_46, caseSensitive))
-    {
+      setHeader(imap, buf + ofs, header, headerState);
+      break;
+    case esp_mail_header_field_return_path:
       headerState = esp_mail_imap_header_state::esp_mail_imap_state_return_path;
-      tmp = subStr(buf, esp_mail_str_46, NULL, 0, -1, caseSensitive);
-      if (tmp)
-      {
-        setHeader(imap, tmp, header, headerState);
-        delP(&tmp);
-      }
-    }
-    else if (strcmpP(buf, 0, esp_mail_str_184, caseSensitive))
-    {
+      setHeader(imap, buf + ofs, header, headerState);
+      break;
+    case esp_mail_header_field_reply_to:
       headerState = esp_mail_imap_header_state::esp_mail_imap_state_reply_to;
-      tmp = subStr(buf, esp_mail_str_184, NULL, 0, -1, caseSensitive);
-      if (tmp)
-      {
-        setHeader(imap, tmp, header, headerState);
-        delP(&tmp);
-      }
-    }
-    else if (strcmpP(buf, 0, esp_mail_str_109, caseSensitive))
-    {
+      setHeader(imap, buf + ofs, header, headerState);
+      break;
+    case esp_mail_header_field_in_reply_to:
       headerState = esp_mail_imap_header_state::esp_mail_imap_state_in_reply_to;
-      tmp = subStr(buf, esp_mail_str_109, NULL, 0, -1, caseSensitive);
-      if (tmp)
-      {
-        setHeader(imap, tmp, header, headerState);
-        delP(&tmp);
-      }
-    }
-    else if (strcmpP(buf, 0, esp_mail_str_107, caseSensitive))
-    {
+      setHeader(imap, buf + ofs, header, headerState);
+      break;
+    case esp_mail_header_field_references:
       headerState = esp_mail_imap_header_state::esp_mail_imap_state_references;
-      tmp = subStr(buf, esp_mail_str_107, NULL, 0, -1, caseSensitive);
-      if (tmp)
-      {
-        setHeader(imap, tmp, header, headerState);
-        delP(&tmp);
-      }
-    }
-    else if (strcmpP(buf, 0, esp_mail_str_134, caseSensitive))
-    {
+      setHeader(imap, buf + ofs, header, headerState);
+      break;
+    case esp_mail_header_field_comments:
       headerState = esp_mail_imap_header_state::esp_mail_imap_state_comments;
-      tmp = subStr(buf, esp_mail_str_134, NULL, 0, -1, caseSensitive);
-      if (tmp)
-      {
-        setHeader(imap, tmp, header, headerState);
-        delP(&tmp);
-      }
-    }
-    else if (strcmpP(buf, 0, esp_mail_str_145, caseSensitive))
-    {
+      setHeader(imap, buf + ofs, header, headerState);
+      break;
+    case esp_mail_header_field_keywords:
       headerState = esp_mail_imap_header_state::esp_mail_imap_state_keywords;
-      tmp = subStr(buf, esp_mail_str_145, NULL, 0, -1, caseSensitive);
-      if (tmp)
-      {
-        setHeader(imap, tmp, header, headerState);
-        delP(&tmp);
-      }
-    }
-    else if (strcmpP(buf, 0, esp_mail_str_25, caseSensitive))
-    {
+      setHeader(imap, buf + ofs, header, headerState);
+      break;
+    case esp_mail_header_field_content_type:
       headerState = esp_mail_imap_header_state::esp_mail_imap_state_content_type;
       tmp = subStr(buf, esp_mail_str_25, esp_mail_str_97, 0, caseSensitive);
       if (tmp)
@@ -2555,56 +2961,29 @@ void ESP_Mail_Client::handleHeader(IMAPSession *imap, char *buf, int bufLen, int
         setHeader(imap, buf, header, headerState);
         delP(&tmp);
       }
-    }
-    else if (strcmpP(buf, 0, esp_mail_str_172, caseSensitive))
-    {
+      break;
+    case esp_mail_header_field_content_transfer_encoding:
       headerState = esp_mail_imap_header_state::esp_mail_imap_state_content_transfer_encoding;
-      tmp = subStr(buf, esp_mail_str_172, NULL, 0, -1, caseSensitive);
-      if (tmp)
-      {
-        setHeader(imap, tmp, header, headerState);
-        delP(&tmp);
-      }
-    }
-    else if (strcmpP(buf, 0, esp_mail_str_190, caseSensitive))
-    {
+      setHeader(imap, buf + ofs, header, headerState);
+      break;
+    case esp_mail_header_field_accept_language:
       headerState = esp_mail_imap_header_state::esp_mail_imap_state_accept_language;
-      tmp = subStr(buf, esp_mail_str_190, NULL, 0, -1, caseSensitive);
-      if (tmp)
-      {
-        setHeader(imap, tmp, header, headerState);
-        delP(&tmp);
-      }
-    }
-    else if (strcmpP(buf, 0, esp_mail_str_191, caseSensitive))
-    {
+      setHeader(imap, buf + ofs, header, headerState);
+      break;
+    case esp_mail_header_field_content_language:
       headerState = esp_mail_imap_header_state::esp_mail_imap_state_content_language;
-      tmp = subStr(buf, esp_mail_str_191, NULL, 0, -1, caseSensitive);
-      if (tmp)
-      {
-        setHeader(imap, tmp, header, headerState);
-        delP(&tmp);
-      }
-    }
-    else if (strcmpP(buf, 0, esp_mail_str_99, caseSensitive))
-    {
+      setHeader(imap, buf + ofs, header, headerState);
+      break;
+    case esp_mail_header_field_date:
       headerState = esp_mail_imap_header_state::esp_mail_imap_state_date;
-      tmp = subStr(buf, esp_mail_str_99, NULL, 0, -1, caseSensitive);
-      if (tmp)
-      {
-        setHeader(imap, tmp, header, headerState);
-        delP(&tmp);
-      }
-    }
-    else if (strcmpP(buf, 0, esp_mail_str_101, caseSensitive))
-    {
+      setHeader(imap, buf + ofs, header, headerState);
+      break;
+    case esp_mail_header_field_msg_id:
       headerState = esp_mail_imap_header_state::esp_mail_imap_state_msg_id;
-      tmp = subStr(buf, esp_mail_str_101, NULL, 0, -1, caseSensitive);
-      if (tmp)
-      {
-        setHeader(imap, tmp, header, headerState);
-        delP(&tmp);
-      }
+      setHeader(imap, buf + ofs, header, headerState);
+      break;
+    default:
+      break;
     }
     chunkIdx++;
   }
@@ -2623,19 +3002,19 @@ void ESP_Mail_Client::setHeader(IMAPSession *imap, char *buf, struct esp_mail_me
   switch (state)
   {
   case esp_mail_imap_header_state::esp_mail_imap_state_from:
-    header.header_fields.from += &buf[i];
+    header.header_fields.append(esp_mail_rfc822_header_field_from, &buf[i]);
     break;
   case esp_mail_imap_header_state::esp_mail_imap_state_sender:
-    header.header_fields.sender += &buf[i];
+    header.header_fields.append(esp_mail_rfc822_header_field_sender, &buf[i]);
     break;
   case esp_mail_imap_header_state::esp_mail_imap_state_to:
-    header.header_fields.to += &buf[i];
+    header.header_fields.append(esp_mail_rfc822_header_field_to, &buf[i]);
     break;
   case esp_mail_imap_header_state::esp_mail_imap_state_cc:
-    header.header_fields.cc += &buf[i];
+    header.header_fields.append(esp_mail_rfc822_header_field_cc, &buf[i]);
     break;
   case esp_mail_imap_header_state::esp_mail_imap_state_subject:
-    header.header_fields.subject += &buf[i];
+    header.header_fields.append(esp_mail_rfc822_header_field_subject, &buf[i]);
     break;
   case esp_mail_imap_header_state::esp_mail_imap_state_content_type:
     header.content_type += &buf[i];
@@ -2650,28 +3029,28 @@ void ESP_Mail_Client::setHeader(IMAPSession *imap, char *buf, struct esp_mail_me
     header.content_language += &buf[i];
     break;
   case esp_mail_imap_header_state::esp_mail_imap_state_date:
-    header.header_fields.date += &buf[i];
+    header.header_fields.append(esp_mail_rfc822_header_field_date, &buf[i]);
     break;
   case esp_mail_imap_header_state::esp_mail_imap_state_msg_id:
-    header.header_fields.messageID += &buf[i];
+    header.header_fields.append(esp_mail_rfc822_header_field_messageID, &buf[i]);
     break;
   case esp_mail_imap_header_state::esp_mail_imap_state_return_path:
-    header.header_fields.return_path += &buf[i];
+    header.header_fields.append(esp_mail_rfc822_header_field_return_path, &buf[i]);
     break;
   case esp_mail_imap_header_state::esp_mail_imap_state_reply_to:
-    header.header_fields.reply_to += &buf[i];
+    header.header_fields.append(esp_mail_rfc822_header_field_reply_to, &buf[i]);
     break;
   case esp_mail_imap_header_state::esp_mail_imap_state_in_reply_to:
-    header.header_fields.in_reply_to += &buf[i];
+    header.header_fields.append(esp_mail_rfc822_header_field_in_reply_to, &buf[i]);
     break;
   case esp_mail_imap_header_state::esp_mail_imap_state_references:
-    header.header_fields.references += &buf[i];
+    header.header_fields.append(esp_mail_rfc822_header_field_references, &buf[i]);
     break;
   case esp_mail_imap_header_state::esp_mail_imap_state_comments:
-    header.header_fields.comments += &buf[i];
+    header.header_fields.append(esp_mail_rfc822_header_field_comments, &buf[i]);
     break;
   case esp_mail_imap_header_state::esp_mail_imap_state_keywords:
-    header.header_fields.keywords += &buf[i];
+    header.header_fields.append(esp_mail_rfc822_header_field_keywords, &buf[i]);
     break;
   case esp_mail_imap_header_state::esp_mail_imap_state_char_set:
     header.char_set += &buf[i];
@@ -2704,62 +3083,65 @@ void ESP_Mail_Client::handlePartHeader(IMAPSession *imap, char *buf, int &chunkI
   }
   else
   {
-    if (strcmpP(buf, 0, esp_mail_str_25, caseSensitive))
+    size_t ofs = 0;
+    esp_mail_header_field field = getHeaderField(buf, ofs);
+
+    if (field == esp_mail_header_field_content_type)
     {
       tmp = subStr(buf, esp_mail_str_25, esp_mail_str_97, 0, 0, caseSensitive);
       bool con_type = false;
       if (tmp)
       {
         con_type = true;
-        part.content_type = tmp;
+        part.content_type = internStr(imap, tmp);
         delP(&tmp);
-        int p1 = strposP(part.content_type.c_str(), esp_mail_imap_composite_media_type_t::multipart, 0, caseSensitive);
+        int p1 = strposP(part.content_type, esp_mail_imap_composite_media_type_t::multipart, 0, caseSensitive);
         if (p1 != -1)
         {
           p1 += strlen(esp_mail_imap_composite_media_type_t::multipart) + 1;
           part.multipart = true;
           //inline or embedded images
-          if (strpos(part.content_type.c_str(), esp_mail_imap_multipart_sub_type_t::related, p1, caseSensitive) != -1)
+          if (strpos(part.content_type, esp_mail_imap_multipart_sub_type_t::related, p1, caseSensitive) != -1)
             part.multipart_sub_type = esp_mail_imap_multipart_sub_type_related;
           //multiple text formats e.g. plain, html, enriched
-          else if (strpos(part.content_type.c_str(), esp_mail_imap_multipart_sub_type_t::alternative, p1, caseSensitive) != -1)
+          else if (strpos(part.content_type, esp_mail_imap_multipart_sub_type_t::alternative, p1, caseSensitive) != -1)
             part.multipart_sub_type = esp_mail_imap_multipart_sub_type_alternative;
           //medias
-          else if (strpos(part.content_type.c_str(), esp_mail_imap_multipart_sub_type_t::parallel, p1, caseSensitive) != -1)
+          else if (strpos(part.content_type, esp_mail_imap_multipart_sub_type_t::parallel, p1, caseSensitive) != -1)
             part.multipart_sub_type = esp_mail_imap_multipart_sub_type_parallel;
           //rfc822 encapsulated
-          else if (strpos(part.content_type.c_str(), esp_mail_imap_multipart_sub_type_t::digest, p1, caseSensitive) != -1)
+          else if (strpos(part.content_type, esp_mail_imap_multipart_sub_type_t::digest, p1, caseSensitive) != -1)
             part.multipart_sub_type = esp_mail_imap_multipart_sub_type_digest;
-          else if (strpos(part.content_type.c_str(), esp_mail_imap_multipart_sub_type_t::report, p1, caseSensitive) != -1)
+          else if (strpos(part.content_type, esp_mail_imap_multipart_sub_type_t::report, p1, caseSensitive) != -1)
             part.multipart_sub_type = esp_mail_imap_multipart_sub_type_report;
           //others can be attachments
-          else if (strpos(part.content_type.c_str(), esp_mail_imap_multipart_sub_type_t::mixed, p1, caseSensitive) != -1)
+          else if (strpos(part.content_type, esp_mail_imap_multipart_sub_type_t::mixed, p1, caseSensitive) != -1)
             part.multipart_sub_type = esp_mail_imap_multipart_sub_type_mixed;
         }
 
-        p1 = strposP(part.content_type.c_str(), esp_mail_imap_composite_media_type_t::message, 0, caseSensitive);
+        p1 = strposP(part.content_type, esp_mail_imap_composite_media_type_t::message, 0, caseSensitive);
         if (p1 != -1)
         {
           p1 += strlen(esp_mail_imap_composite_media_type_t::message) + 1;
-          if (strpos(part.content_type.c_str(), esp_mail_imap_message_sub_type_t::rfc822, p1, caseSensitive) != -1)
+          if (strpos(part.content_type, esp_mail_imap_message_sub_type_t::rfc822, p1, caseSensitive) != -1)
             part.message_sub_type = esp_mail_imap_message_sub_type_rfc822;
-          else if (strpos(part.content_type.c_str(), esp_mail_imap_message_sub_type_t::Partial, p1, caseSensitive) != -1)
+          else if (strpos(part.content_type, esp_mail_imap_message_sub_type_t::Partial, p1, caseSensitive) != -1)
             part.message_sub_type = esp_mail_imap_message_sub_type_partial;
-          else if (strpos(part.content_type.c_str(), esp_mail_imap_message_sub_type_t::External_Body, p1, caseSensitive) != -1)
+          else if (strpos(part.content_type, esp_mail_imap_message_sub_type_t::External_Body, p1, caseSensitive) != -1)
             part.message_sub_type = esp_mail_imap_message_sub_type_external_body;
-          else if (strpos(part.content_type.c_str(), esp_mail_imap_message_sub_type_t::delivery_status, p1, caseSensitive) != -1)
+          else if (strpos(part.content_type, esp_mail_imap_message_sub_type_t::delivery_status, p1, caseSensitive) != -1)
             part.message_sub_type = esp_mail_imap_message_sub_type_delivery_status;
         }
 
-        p1 = strpos(part.content_type.c_str(), esp_mail_imap_descrete_media_type_t::text, 0, caseSensitive);
+        p1 = strpos(part.content_type, esp_mail_imap_descrete_media_type_t::text, 0, caseSensitive);
         if (p1 != -1)
         {
           p1 += strlen(esp_mail_imap_descrete_media_type_t::text) + 1;
-          if (strpos(part.content_type.c_str(), esp_mail_imap_media_text_sub_type_t::plain, p1, caseSensitive) != -1)
+          if (strpos(part.content_type, esp_mail_imap_media_text_sub_type_t::plain, p1, caseSensitive) != -1)
             part.msg_type = esp_mail_msg_type_plain;
-          else if (strpos(part.content_type.c_str(), esp_mail_imap_media_text_sub_type_t::enriched, p1, caseSensitive) != -1)
+          else if (strpos(part.content_type, esp_mail_imap_media_text_sub_type_t::enriched, p1, caseSensitive) != -1)
             part.msg_type = esp_mail_msg_type_enriched;
-          else if (strpos(part.content_type.c_str(), esp_mail_imap_media_text_sub_type_t::html, p1, caseSensitive) != -1)
+          else if (strpos(part.content_type, esp_mail_imap_media_text_sub_type_t::html, p1, caseSensitive) != -1)
             part.msg_type = esp_mail_msg_type_html;
           else
             part.msg_type = esp_mail_msg_type_plain;
@@ -2773,7 +3155,7 @@ void ESP_Mail_Client::handlePartHeader(IMAPSession *imap, char *buf, int &chunkI
           tmp = subStr(buf, esp_mail_str_168, esp_mail_str_136, 0, 0, caseSensitive);
           if (tmp)
           {
-            part.charset = tmp;
+            part.charset = internStr(imap, tmp);
             delP(&tmp);
           }
           else
@@ -2781,7 +3163,7 @@ void ESP_Mail_Client::handlePartHeader(IMAPSession *imap, char *buf, int &chunkI
             tmp = subStr(buf, esp_mail_str_169, NULL, 0, -1, caseSensitive);
             if (tmp)
             {
-              part.charset = tmp;
+              part.charset = internStr(imap, tmp);
               delP(&tmp);
             }
           }
@@ -2792,205 +3174,100 @@ void ESP_Mail_Client::handlePartHeader(IMAPSession *imap, char *buf, int &chunkI
             part.plain_delsp = true;
         }
 
-        if (part.charset.length() == 0)
+        if (strlen(part.charset) == 0)
         {
           tmp = subStr(buf, esp_mail_str_168, esp_mail_str_136, 0, 0, caseSensitive);
           if (tmp)
-          {
-            part.charset = tmp;
-            delP(&tmp);
-          }
-          else
-          {
-            tmp = subStr(buf, esp_mail_str_169, NULL, 0, -1, caseSensitive);
-            if (tmp)
-            {
-              part.charset = tmp;
-              delP(&tmp);
-            }
-          }
-        }
-
-        tmp = subStr(buf, esp_mail_str_170, esp_mail_str_136, 0, 0, caseSensitive);
-        if (tmp)
-        {
-          part.name = tmp;
-          delP(&tmp);
-        }
-        else
-        {
-          tmp = subStr(buf, esp_mail_str_171, NULL, 0, -1, caseSensitive);
-          if (tmp)
-          {
-            part.name = tmp;
-            delP(&tmp);
-          }
-        }
-      }
-    }
-    else if (strcmpP(buf, 0, esp_mail_str_172, caseSensitive))
-    {
-      tmp = subStr(buf, esp_mail_str_172, NULL, 0, -1, caseSensitive);
-      if (tmp)
-      {
-        part.content_transfer_encoding = tmp;
-        delP(&tmp);
-      }
-    }
-    else if (strcmpP(buf, 0, esp_mail_str_174, caseSensitive))
-    {
-      tmp = subStr(buf, esp_mail_str_174, NULL, 0, -1, caseSensitive);
-      if (tmp)
-      {
-        part.descr = tmp;
-        delP(&tmp);
-      }
-    }
-    else if (strcmpP(buf, 0, esp_mail_str_175, caseSensitive))
-    {
-      tmp = subStr(buf, esp_mail_str_175, esp_mail_str_97, 0, 0, caseSensitive);
-      if (tmp)
-      {
-
-        //don't count altenative part text and html as embedded contents
-        if (cHeader(imap)->multipart_sub_type != esp_mail_imap_multipart_sub_type_alternative)
-        {
-          part.content_disposition = tmp;
-          if (caseSensitive)
-          {
-            if (strcmp(tmp, esp_mail_imap_content_disposition_type_t::attachment) == 0)
-              part.attach_type = esp_mail_att_type_attachment;
-            else if (strcmp(tmp, esp_mail_imap_content_disposition_type_t::inline_) == 0)
-              part.attach_type = esp_mail_att_type_inline;
-          }
-          else
-          {
-            if (strcasecmp(tmp, esp_mail_imap_content_disposition_type_t::attachment) == 0)
-              part.attach_type = esp_mail_att_type_attachment;
-            else if (strcasecmp(tmp, esp_mail_imap_content_disposition_type_t::inline_) == 0)
-              part.attach_type = esp_mail_att_type_inline;
-          }
-        }
-        delP(&tmp);
-      }
-    }
-    else if (strcmpP(buf, 0, esp_mail_str_150, caseSensitive))
-    {
-      tmp = subStr(buf, esp_mail_str_150, NULL, 0, -1, caseSensitive);
-      if (tmp)
-      {
-        part.rfc822_header.sender = tmp;
-        delP(&tmp);
-      }
-    }
-    else if (strcmpP(buf, 0, esp_mail_str_10, caseSensitive))
-    {
-      tmp = subStr(buf, esp_mail_str_10, NULL, 0, -1, caseSensitive);
-      if (tmp)
-      {
-        part.rfc822_header.from = tmp;
-        delP(&tmp);
-      }
-    }
-    else if (strcmpP(buf, 0, esp_mail_str_11, caseSensitive))
-    {
-      tmp = subStr(buf, esp_mail_str_11, NULL, 0, -1, caseSensitive);
-      if (tmp)
-      {
-        part.rfc822_header.to = tmp;
-        delP(&tmp);
-      }
-    }
-    else if (strcmpP(buf, 0, esp_mail_str_12, caseSensitive))
-    {
-      tmp = subStr(buf, esp_mail_str_12, NULL, 0, -1, caseSensitive);
-      if (tmp)
-      {
-        part.rfc822_header.cc = tmp;
-        delP(&tmp);
-      }
-    }
-    else if (strcmpP(buf, 0, esp_mail_str_184, caseSensitive))
-    {
-      tmp = subStr(buf, esp_mail_str_184, NULL, 0, -1, caseSensitive);
-      if (tmp)
-      {
-        part.rfc822_header.reply_to = tmp;
-        delP(&tmp);
-      }
-    }
-    else if (strcmpP(buf, 0, esp_mail_str_134, caseSensitive))
-    {
-      tmp = subStr(buf, esp_mail_str_134, NULL, 0, -1, caseSensitive);
-      if (tmp)
-      {
-        part.rfc822_header.comments = tmp;
-        delP(&tmp);
-      }
-    }
-    else if (strcmpP(buf, 0, esp_mail_str_24, caseSensitive))
-    {
-      tmp = subStr(buf, esp_mail_str_24, NULL, 0, -1, caseSensitive);
-      if (tmp)
-      {
-        part.rfc822_header.subject = tmp;
-        delP(&tmp);
-      }
-    }
-    else if (strcmpP(buf, 0, esp_mail_str_101, caseSensitive))
-    {
-      tmp = subStr(buf, esp_mail_str_101, NULL, 0, -1, caseSensitive);
-      if (tmp)
-      {
-        part.rfc822_header.messageID = tmp;
-        delP(&tmp);
-      }
-    }
-    else if (strcmpP(buf, 0, esp_mail_str_46, caseSensitive))
-    {
-      tmp = subStr(buf, esp_mail_str_46, NULL, 0, -1, caseSensitive);
-      if (tmp)
-      {
-        part.rfc822_header.return_path = tmp;
-        delP(&tmp);
-      }
-    }
-    else if (strcmpP(buf, 0, esp_mail_str_99, caseSensitive))
-    {
-      tmp = subStr(buf, esp_mail_str_99, NULL, 0, -1, caseSensitive);
-      if (tmp)
-      {
-        part.rfc822_header.date = tmp;
-        delP(&tmp);
-      }
-    }
-    else if (strcmpP(buf, 0, esp_mail_str_145, caseSensitive))
-    {
-      tmp = subStr(buf, esp_mail_str_145, NULL, 0, -1, caseSensitive);
-      if (tmp)
-      {
-        part.rfc822_header.keywords = tmp;
-        delP(&tmp);
-      }
-    }
-    else if (strcmpP(buf, 0, esp_mail_str_109, caseSensitive))
-    {
-      tmp = subStr(buf, esp_mail_str_109, NULL, 0, -1, caseSensitive);
-      if (tmp)
-      {
-        part.rfc822_header.in_reply_to = tmp;
-        delP(&tmp);
+          {
+            part.charset = internStr(imap, tmp);
+            delP(&tmp);
+          }
+          else
+          {
+            tmp = subStr(buf, esp_mail_str_169, NULL, 0, -1, caseSensitive);
+            if (tmp)
+            {
+              part.charset = internStr(imap, tmp);
+              delP(&tmp);
+            }
+          }
+        }
+
+        tmp = subStr(buf, esp_mail_str_170, esp_mail_str_136, 0, 0, caseSensitive);
+        if (tmp)
+        {
+          part.name = tmp;
+          delP(&tmp);
+        }
+        else
+        {
+          tmp = subStr(buf, esp_mail_str_171, NULL, 0, -1, caseSensitive);
+          if (tmp)
+          {
+            part.name = tmp;
+            delP(&tmp);
+          }
+        }
       }
     }
-    else if (strcmpP(buf, 0, esp_mail_str_107, caseSensitive))
+    else if (field == esp_mail_header_field_content_transfer_encoding)
+      part.content_transfer_encoding = internStr(imap, buf + ofs);
+    else if (field == esp_mail_header_field_content_description)
+      part.descr = buf + ofs;
+    else if (field == esp_mail_header_field_content_disposition)
     {
-      tmp = subStr(buf, esp_mail_str_107, NULL, 0, -1, caseSensitive);
+      tmp = subStr(buf, esp_mail_str_175, esp_mail_str_97, 0, 0, caseSensitive);
       if (tmp)
       {
-        part.rfc822_header.references = tmp;
+
+        //don't count altenative part text and html as embedded contents
+        if (cHeader(imap)->multipart_sub_type != esp_mail_imap_multipart_sub_type_alternative)
+        {
+          part.content_disposition = tmp;
+          if (caseSensitive)
+          {
+            if (strcmp(tmp, esp_mail_imap_content_disposition_type_t::attachment) == 0)
+              part.attach_type = esp_mail_att_type_attachment;
+            else if (strcmp(tmp, esp_mail_imap_content_disposition_type_t::inline_) == 0)
+              part.attach_type = esp_mail_att_type_inline;
+          }
+          else
+          {
+            if (strcasecmp(tmp, esp_mail_imap_content_disposition_type_t::attachment) == 0)
+              part.attach_type = esp_mail_att_type_attachment;
+            else if (strcasecmp(tmp, esp_mail_imap_content_disposition_type_t::inline_) == 0)
+              part.attach_type = esp_mail_att_type_inline;
+          }
+        }
         delP(&tmp);
       }
     }
+    else if (field == esp_mail_header_field_sender)
+      part.rfc822_header.set(esp_mail_rfc822_header_field_sender, buf + ofs);
+    else if (field == esp_mail_header_field_from)
+      part.rfc822_header.set(esp_mail_rfc822_header_field_from, buf + ofs);
+    else if (field == esp_mail_header_field_to)
+      part.rfc822_header.set(esp_mail_rfc822_header_field_to, buf + ofs);
+    else if (field == esp_mail_header_field_cc)
+      part.rfc822_header.set(esp_mail_rfc822_header_field_cc, buf + ofs);
+    else if (field == esp_mail_header_field_reply_to)
+      part.rfc822_header.set(esp_mail_rfc822_header_field_reply_to, buf + ofs);
+    else if (field == esp_mail_header_field_comments)
+      part.rfc822_header.set(esp_mail_rfc822_header_field_comments, buf + ofs);
+    else if (field == esp_mail_header_field_subject)
+      part.rfc822_header.set(esp_mail_rfc822_header_field_subject, buf + ofs);
+    else if (field == esp_mail_header_field_msg_id)
+      part.rfc822_header.set(esp_mail_rfc822_header_field_messageID, buf + ofs);
+    else if (field == esp_mail_header_field_return_path)
+      part.rfc822_header.set(esp_mail_rfc822_header_field_return_path, buf + ofs);
+    else if (field == esp_mail_header_field_date)
+      part.rfc822_header.set(esp_mail_rfc822_header_field_date, buf + ofs);
+    else if (field == esp_mail_header_field_keywords)
+      part.rfc822_header.set(esp_mail_rfc822_header_field_keywords, buf + ofs);
+    else if (field == esp_mail_header_field_in_reply_to)
+      part.rfc822_header.set(esp_mail_rfc822_header_field_in_reply_to, buf + ofs);
+    else if (field == esp_mail_header_field_references)
+      part.rfc822_header.set(esp_mail_rfc822_header_field_references, buf + ofs);
 
     if (part.content_disposition.length() > 0)
     {
@@ -3086,6 +3363,7 @@ void ESP_Mail_Client::closeTCPSession(IMAPSession *imap)
     _lastReconnectMillis = millis();
   }
   imap->_tcpConnected = false;
+  clearReader(imap->_reader);
 }
 
 bool ESP_Mail_Client::reconnect(IMAPSession *imap, unsigned long dataTime, bool downloadRequest)
@@ -3162,13 +3440,40 @@ bool ESP_Mail_Client::reconnect(IMAPSession *imap, unsigned long dataTime, bool
 
 int ESP_Mail_Client::available(IMAPSession *imap)
 {
-  int sz = 0;
-  if (imap->tcpClient.stream())
-    sz = imap->tcpClient.stream()->available();
-  return sz;
+  return readerAvailable(imap->tcpClient.stream(), imap->_reader);
 }
 
 bool ESP_Mail_Client::handleIMAPResponse(IMAPSession *imap, int errCode, bool closeSession)
+{
+  static const uint16_t bucketLimits[ESP_MAIL_IMAP_LATENCY_BUCKETS - 1] = {50, 100, 250, 500, 1000, 2500, 5000};
+
+  unsigned long ms = millis();
+  size_t readBytes = imap->_readBytes;
+
+  bool ret = mHandleIMAPResponse(imap, errCode, closeSession);
+
+  if (imap->_imap_cmd < esp_mail_imap_cmd_max)
+  {
+    struct esp_mail_imap_command_stats_t *stats = &imap->_cmdStats[imap->_imap_cmd];
+    uint32_t time = millis() - ms;
+    int bucket = 0;
+    while (bucket < ESP_MAIL_IMAP_LATENCY_BUCKETS - 1 && time >= bucketLimits[bucket])
+      bucket++;
+
+    stats->count++;
+    stats->totalTime += time;
+    stats->histogram[bucket]++;
+    stats->readBytes += imap->_readBytes - readBytes;
+    //the command was sent before waiting for its response
+    stats->writeBytes += imap->_sentBytes - imap->_statSentBytes;
+  }
+
+  imap->_statSentBytes = imap->_sentBytes;
+
+  return ret;
+}
+
+bool ESP_Mail_Client::mHandleIMAPResponse(IMAPSession *imap, int errCode, bool closeSession)
 {
 
   if (!reconnect(imap))
@@ -3198,9 +3503,13 @@ bool ESP_Mail_Client::handleIMAPResponse(IMAPSession *imap, int errCode, bool cl
   int dcnt = -1;
   char *skey = nullptr;
   char *spc = nullptr;
-  char *lastBuf = nullptr;
   char *tmp = nullptr;
-  bool crLF = imap->_imap_cmd == esp_mail_imap_cmd_fetch_body_text && strcmpP(cPart(imap)->content_transfer_encoding.c_str(), 0, esp_mail_str_31);
+  //the base64 lines are read with their CRLF, the decoder skips it
+  bool crLF = (imap->_imap_cmd == esp_mail_imap_cmd_fetch_body_text || imap->_imap_cmd == esp_mail_imap_cmd_fetch_body_attachment || imap->_imap_cmd == esp_mail_imap_cmd_fetch_body_inline) && strcmpP(cPart(imap)->content_transfer_encoding, 0, esp_mail_str_31);
+
+  //the quoted-printable lines are read with their CRLF to tell the soft line breaks from the hard ones
+  if (imap->_imap_cmd == esp_mail_imap_cmd_fetch_body_text && strcmpP(cPart(imap)->content_transfer_encoding, 0, esp_mail_str_278))
+    crLF = true;
 
   while (imap->_tcpConnected && chunkBufSize <= 0)
   {
@@ -3245,9 +3554,6 @@ bool ESP_Mail_Client::handleIMAPResponse(IMAPSession *imap, int errCode, bool cl
       spc = strP(esp_mail_str_92);
     }
 
-    if (imap->_imap_cmd == esp_mail_imap_cmd_fetch_body_attachment || imap->_imap_cmd == esp_mail_imap_cmd_fetch_body_inline)
-      lastBuf = (char *)newP(BASE64_CHUNKED_LEN + 1);
-
     while (!completedResponse)
     {
       delay(0);
@@ -3279,7 +3585,9 @@ bool ESP_Mail_Client::handleIMAPResponse(IMAPSession *imap, int errCode, bool cl
         }
         else
         {
-          readLen = readLine(imap->tcpClient.stream(), response, chunkBufSize, crLF, octetCount);
+          int count = octetCount;
+          readLen = readLine(imap->tcpClient.stream(), imap->_reader, response, chunkBufSize, crLF, octetCount);
+          imap->_readBytes += octetCount - count;
         }
 
         if (readLen)
@@ -3314,7 +3622,9 @@ bool ESP_Mail_Client::handleIMAPResponse(IMAPSession *imap, int errCode, bool cl
               //try to read the next available response
               memset(response, 0, chunkBufSize);
 
-              readLen = readLine(imap->tcpClient.stream(), response, chunkBufSize, true, octetCount);
+              int count = octetCount;
+              readLen = readLine(imap->tcpClient.stream(), imap->_reader, response, chunkBufSize, true, octetCount);
+              imap->_readBytes += octetCount - count;
               if (readLen)
               {
                 completedResponse = false;
@@ -3354,9 +3664,7 @@ bool ESP_Mail_Client::handleIMAPResponse(IMAPSession *imap, int errCode, bool cl
             {
               if (headerState == 0)
               {
-                char *tmp = intStr(cMSG(imap));
-                header.message_uid = atoi(tmp);
-                delP(&tmp);
+                header.message_uid = cMSG(imap);
               }
               int _st = headerState;
               handleHeader(imap, response, readLen, chunkIdx, header, headerState, octetCount, imap->_config->enable.header_case_sensitive);
@@ -3369,36 +3677,9 @@ bool ESP_Mail_Client::handleIMAPResponse(IMAPSession *imap, int errCode, bool cl
               decodeText(imap, response, readLen, chunkIdx, file, filePath, downloadRequest, octetLength, octetCount, dcnt);
             else if (imap->_imap_cmd == esp_mail_imap_cmd_fetch_body_attachment || imap->_imap_cmd == esp_mail_imap_cmd_fetch_body_inline)
             {
-
-              if (strcmpP(cPart(imap)->content_transfer_encoding.c_str(), 0, esp_mail_str_31))
-              {
-                //multi-line chunked base64 string attachment handle
-                if (octetCount < octetLength && readLen < BASE64_CHUNKED_LEN)
-                {
-                  if (strlen(lastBuf) > 0)
-                  {
-                    tmp = (char *)newP(readLen + strlen(lastBuf) + 2);
-                    strcpy(tmp, lastBuf);
-                    strcat(tmp, response);
-                    readLen = strlen(tmp);
-                    tmo = handleAttachment(imap, tmp, readLen, chunkIdx, file, filePath, downloadRequest, octetCount, octetLength, oCount, reportState, dcnt);
-                    delP(&tmp);
-                    memset(lastBuf, 0, BASE64_CHUNKED_LEN + 1);
-                    if (!tmo)
-                      break;
-                  }
-                  else if (readLen < BASE64_CHUNKED_LEN + 1)
-                    strcpy(lastBuf, response);
-                }
-                else
-                {
-                  tmo = handleAttachment(imap, response, readLen, chunkIdx, file, filePath, downloadRequest, octetCount, octetLength, oCount, reportState, dcnt);
-                  if (!tmo)
-                    break;
-                }
-              }
-              else
-                tmo = handleAttachment(imap, response, readLen, chunkIdx, file, filePath, downloadRequest, octetCount, octetLength, oCount, reportState, dcnt);
+              tmo = handleAttachment(imap, response, readLen, chunkIdx, file, filePath, downloadRequest, octetCount, octetLength, oCount, reportState, dcnt);
+              if (!tmo)
+                break;
             }
             dataTime = millis();
           }
@@ -3415,8 +3696,6 @@ bool ESP_Mail_Client::handleIMAPResponse(IMAPSession *imap, int errCode, bool cl
       delP(&skey);
       delP(&spc);
     }
-    if (imap->_imap_cmd == esp_mail_imap_cmd_fetch_body_attachment)
-      delP(&lastBuf);
   }
 
   if ((imap->_imap_cmd == esp_mail_imap_cmd_fetch_body_header && header.header_data_len == 0) || imapResp == esp_mail_imap_response_status::esp_mail_imap_resp_no)
@@ -3466,21 +3745,21 @@ bool ESP_Mail_Client::handleIMAPResponse(IMAPSession *imap, int errCode, bool cl
           p1 += strlen(esp_mail_imap_composite_media_type_t::multipart) + 1;
           header.multipart = true;
           //inline or embedded images
-          if (strpos(part.content_type.c_str(), esp_mail_imap_multipart_sub_type_t::related, p1) != -1)
+          if (strpos(part.content_type, esp_mail_imap_multipart_sub_type_t::related, p1) != -1)
             header.multipart_sub_type = esp_mail_imap_multipart_sub_type_related;
           //multiple text formats e.g. plain, html, enriched
-          else if (strpos(part.content_type.c_str(), esp_mail_imap_multipart_sub_type_t::alternative, p1) != -1)
+          else if (strpos(part.content_type, esp_mail_imap_multipart_sub_type_t::alternative, p1) != -1)
             header.multipart_sub_type = esp_mail_imap_multipart_sub_type_alternative;
           //medias
-          else if (strpos(part.content_type.c_str(), esp_mail_imap_multipart_sub_type_t::parallel, p1) != -1)
+          else if (strpos(part.content_type, esp_mail_imap_multipart_sub_type_t::parallel, p1) != -1)
             header.multipart_sub_type = esp_mail_imap_multipart_sub_type_parallel;
           //rfc822 encapsulated
-          else if (strpos(part.content_type.c_str(), esp_mail_imap_multipart_sub_type_t::digest, p1) != -1)
+          else if (strpos(part.content_type, esp_mail_imap_multipart_sub_type_t::digest, p1) != -1)
             header.multipart_sub_type = esp_mail_imap_multipart_sub_type_digest;
-          else if (strpos(part.content_type.c_str(), esp_mail_imap_multipart_sub_type_t::report, p1) != -1)
+          else if (strpos(part.content_type, esp_mail_imap_multipart_sub_type_t::report, p1) != -1)
             header.multipart_sub_type = esp_mail_imap_multipart_sub_type_report;
           //others can be attachments
-          else if (strpos(part.content_type.c_str(), esp_mail_imap_multipart_sub_type_t::mixed, p1) != -1)
+          else if (strpos(part.content_type, esp_mail_imap_multipart_sub_type_t::mixed, p1) != -1)
             header.multipart_sub_type = esp_mail_imap_multipart_sub_type_mixed;
         }
 
@@ -3488,16 +3767,16 @@ bool ESP_Mail_Client::handleIMAPResponse(IMAPSession *imap, int errCode, bool cl
         if (p1 != -1)
         {
           p1 += strlen(esp_mail_imap_composite_media_type_t::message) + 1;
-          if (strpos(part.content_type.c_str(), esp_mail_imap_message_sub_type_t::rfc822, p1) != -1)
+          if (strpos(part.content_type, esp_mail_imap_message_sub_type_t::rfc822, p1) != -1)
           {
             header.rfc822_part = true;
             header.message_sub_type = esp_mail_imap_message_sub_type_rfc822;
           }
-          else if (strpos(part.content_type.c_str(), esp_mail_imap_message_sub_type_t::Partial, p1) != -1)
+          else if (strpos(part.content_type, esp_mail_imap_message_sub_type_t::Partial, p1) != -1)
             header.message_sub_type = esp_mail_imap_message_sub_type_partial;
-          else if (strpos(part.content_type.c_str(), esp_mail_imap_message_sub_type_t::External_Body, p1) != -1)
+          else if (strpos(part.content_type, esp_mail_imap_message_sub_type_t::External_Body, p1) != -1)
             header.message_sub_type = esp_mail_imap_message_sub_type_external_body;
-          else if (strpos(part.content_type.c_str(), esp_mail_imap_message_sub_type_t::delivery_status, p1) != -1)
+          else if (strpos(part.content_type, esp_mail_imap_message_sub_type_t::delivery_status, p1) != -1)
             header.message_sub_type = esp_mail_imap_message_sub_type_delivery_status;
         }
 
@@ -3526,21 +3805,8 @@ bool ESP_Mail_Client::handleIMAPResponse(IMAPSession *imap, int errCode, bool cl
 
       delP(&buf);
 
-      decodeHeader(header.header_fields.messageID);
-      decodeHeader(header.header_fields.from);
-      decodeHeader(header.header_fields.sender);
-      decodeHeader(header.header_fields.to);
-      decodeHeader(header.header_fields.cc);
-      decodeHeader(header.header_fields.bcc);
-      decodeHeader(header.header_fields.subject);
-      decodeHeader(header.header_fields.date);
-      decodeHeader(header.header_fields.return_path);
-      decodeHeader(header.header_fields.reply_to);
-      decodeHeader(header.header_fields.in_reply_to);
-      decodeHeader(header.header_fields.references);
-      decodeHeader(header.header_fields.comments);
-      decodeHeader(header.header_fields.keywords);
-      imap->_headers.push_back(header);
+      decodeHeaderFields(header.header_fields);
+      imap->_headers.push_back(std::move(header));
     }
 
     if (imap->_imap_cmd == esp_mail_imap_cmd_fetch_body_mime)
@@ -3658,12 +3924,12 @@ void ESP_Mail_Client::saveHeader(IMAPSession *imap)
       file.print(s.c_str());
       file.println(cHeader(imap)->message_uid);
 
-      if (cHeader(imap)->header_fields.messageID.length() > 0)
+      if (cHeader(imap)->header_fields.length(esp_mail_rfc822_header_field_messageID) > 0)
       {
         appendP(s, esp_mail_str_101, true);
         appendP(s, esp_mail_str_131, false);
         file.print(s.c_str());
-        file.println(cHeader(imap)->header_fields.messageID.c_str());
+        file.println(cHeader(imap)->header_fields.get(esp_mail_rfc822_header_field_messageID));
       }
 
       if (cHeader(imap)->accept_language.length() > 0)
@@ -3680,99 +3946,99 @@ void ESP_Mail_Client::saveHeader(IMAPSession *imap)
         file.println(cHeader(imap)->content_language.c_str());
       }
 
-      if (cHeader(imap)->header_fields.from.length() > 0)
+      if (cHeader(imap)->header_fields.length(esp_mail_rfc822_header_field_from) > 0)
       {
         appendP(s, esp_mail_str_10, true);
         appendP(s, esp_mail_str_131, false);
         file.print(s.c_str());
-        file.println(cHeader(imap)->header_fields.from.c_str());
+        file.println(cHeader(imap)->header_fields.get(esp_mail_rfc822_header_field_from));
       }
 
-      if (cHeader(imap)->header_fields.sender.length() > 0)
+      if (cHeader(imap)->header_fields.length(esp_mail_rfc822_header_field_sender) > 0)
       {
         appendP(s, esp_mail_str_150, true);
         appendP(s, esp_mail_str_131, false);
         file.print(s.c_str());
-        file.println(cHeader(imap)->header_fields.sender.c_str());
+        file.println(cHeader(imap)->header_fields.get(esp_mail_rfc822_header_field_sender));
       }
 
-      if (cHeader(imap)->header_fields.to.length() > 0)
+      if (cHeader(imap)->header_fields.length(esp_mail_rfc822_header_field_to) > 0)
       {
         appendP(s, esp_mail_str_11, true);
         appendP(s, esp_mail_str_131, false);
         file.print(s.c_str());
-        file.println(cHeader(imap)->header_fields.to.c_str());
+        file.println(cHeader(imap)->header_fields.get(esp_mail_rfc822_header_field_to));
       }
 
-      if (cHeader(imap)->header_fields.cc.length() > 0)
+      if (cHeader(imap)->header_fields.length(esp_mail_rfc822_header_field_cc) > 0)
       {
         appendP(s, esp_mail_str_108, true);
         file.print(s.c_str());
-        file.println(cHeader(imap)->header_fields.cc.c_str());
+        file.println(cHeader(imap)->header_fields.get(esp_mail_rfc822_header_field_cc));
       }
 
-      if (cHeader(imap)->header_fields.date.length() > 0)
+      if (cHeader(imap)->header_fields.length(esp_mail_rfc822_header_field_date) > 0)
       {
         appendP(s, esp_mail_str_99, true);
         appendP(s, esp_mail_str_131, false);
         file.print(s.c_str());
-        file.println(cHeader(imap)->header_fields.date.c_str());
+        file.println(cHeader(imap)->header_fields.get(esp_mail_rfc822_header_field_date));
       }
 
-      if (cHeader(imap)->header_fields.subject.length() > 0)
+      if (cHeader(imap)->header_fields.length(esp_mail_rfc822_header_field_subject) > 0)
       {
         appendP(s, esp_mail_str_24, true);
         appendP(s, esp_mail_str_131, true);
         file.print(s.c_str());
-        file.println(cHeader(imap)->header_fields.subject.c_str());
+        file.println(cHeader(imap)->header_fields.get(esp_mail_rfc822_header_field_subject));
       }
 
-      if (cHeader(imap)->header_fields.reply_to.length() > 0)
+      if (cHeader(imap)->header_fields.length(esp_mail_rfc822_header_field_reply_to) > 0)
       {
         appendP(s, esp_mail_str_184, true);
         appendP(s, esp_mail_str_131, false);
         file.print(s.c_str());
-        file.println(cHeader(imap)->header_fields.reply_to.c_str());
+        file.println(cHeader(imap)->header_fields.get(esp_mail_rfc822_header_field_reply_to));
       }
 
-      if (cHeader(imap)->header_fields.return_path.length() > 0)
+      if (cHeader(imap)->header_fields.length(esp_mail_rfc822_header_field_return_path) > 0)
       {
         appendP(s, esp_mail_str_46, true);
         appendP(s, esp_mail_str_131, false);
         file.print(s.c_str());
-        file.println(cHeader(imap)->header_fields.return_path.c_str());
+        file.println(cHeader(imap)->header_fields.get(esp_mail_rfc822_header_field_return_path));
       }
 
-      if (cHeader(imap)->header_fields.in_reply_to.length() > 0)
+      if (cHeader(imap)->header_fields.length(esp_mail_rfc822_header_field_in_reply_to) > 0)
       {
         appendP(s, esp_mail_str_109, true);
         appendP(s, esp_mail_str_131, false);
         file.print(s.c_str());
-        file.println(cHeader(imap)->header_fields.in_reply_to.c_str());
+        file.println(cHeader(imap)->header_fields.get(esp_mail_rfc822_header_field_in_reply_to));
       }
 
-      if (cHeader(imap)->header_fields.references.length() > 0)
+      if (cHeader(imap)->header_fields.length(esp_mail_rfc822_header_field_references) > 0)
       {
         appendP(s, esp_mail_str_107, true);
         appendP(s, esp_mail_str_131, false);
         file.print(s.c_str());
-        file.println(cHeader(imap)->header_fields.references.c_str());
+        file.println(cHeader(imap)->header_fields.get(esp_mail_rfc822_header_field_references));
       }
 
-      if (cHeader(imap)->header_fields.comments.length() > 0)
+      if (cHeader(imap)->header_fields.length(esp_mail_rfc822_header_field_comments) > 0)
       {
         appendP(s, esp_mail_str_134, true);
         appendP(s, esp_mail_str_131, false);
         file.print(s.c_str());
-        file.println(cHeader(imap)->header_fields.comments.c_str());
+        file.println(cHeader(imap)->header_fields.get(esp_mail_rfc822_header_field_comments));
       }
 
-      if (cHeader(imap)->header_fields.keywords.length() > 0)
+      if (cHeader(imap)->header_fields.length(esp_mail_rfc822_header_field_keywords) > 0)
       {
         appendP(s, esp_mail_str_145, true);
         appendP(s, esp_mail_str_131, false);
         file.print(s.c_str());
-        file.println(cHeader(imap)->header_fields.keywords.c_str());
+        file.println(cHeader(imap)->header_fields.get(esp_mail_rfc822_header_field_keywords));
       }
 
       if (cHeader(imap)->attachment_count > 0)
@@ -3788,7 +4054,7 @@ void ESP_Mail_Client::saveHeader(IMAPSession *imap)
             continue;
           struct esp_mail_attachment_info_t att;
           att.filename = imap->_headers[cIdx(imap)].part_headers[j].filename.c_str();
-          att.mime = imap->_headers[cIdx(imap)].part_headers[j].content_type.c_str();
+          att.mime = imap->_headers[cIdx(imap)].part_headers[j].content_type;
           att.name = imap->_headers[cIdx(imap)].part_headers[j].name.c_str();
           att.size = imap->_headers[cIdx(imap)].part_headers[j].attach_data_size;
           att.creationDate = imap->_headers[cIdx(imap)].part_headers[j].creation_date.c_str();
@@ -3940,7 +4206,7 @@ bool ESP_Mail_Client::handleIdle(IMAPSession *imap)
     return false;
 
   if (imap->tcpClient.stream())
-    chunkBufSize = imap->tcpClient.stream()->available();
+    chunkBufSize = available(imap);
   else
     return false;
 
@@ -3952,7 +4218,7 @@ bool ESP_Mail_Client::handleIdle(IMAPSession *imap)
 
     int octetCount = 0;
 
-    int readLen = MailClient.readLine(imap->tcpClient.stream(), buf, chunkBufSize, false, octetCount);
+    int readLen = MailClient.readLine(imap->tcpClient.stream(), imap->_reader, buf, chunkBufSize, false, octetCount);
 
     if (readLen > 0)
     {
@@ -4196,6 +4462,7 @@ bool ESP_Mail_Client::handleAttachment(IMAPSession *imap, char *buf, int bufLen,
       delP(&tmp);
       chunkIdx++;
       cHeader(imap)->total_download_size += octetLength;
+      imap->_b64Decoder = esp_mail_base64_decoder_t();
     }
     return true;
   }
@@ -4205,6 +4472,10 @@ bool ESP_Mail_Client::handleAttachment(IMAPSession *imap, char *buf, int bufLen,
 
   chunkIdx++;
 
+  //the base64 lines are read with their CRLF, the other lines without it
+  bool base64 = strcmpP(cPart(imap)->content_transfer_encoding, 0, esp_mail_str_31);
+  int lineEnd = base64 ? 0 : 2;
+
   delay(0);
 
   if (!cPart(imap)->file_open_write)
@@ -4230,9 +4501,7 @@ bool ESP_Mail_Client::handleAttachment(IMAPSession *imap, char *buf, int bufLen,
       filePath += imap->_config->storage.saved_path;
       appendP(filePath, esp_mail_str_202, false);
 
-      char *tmp = intStr(cMSG(imap));
-      filePath += tmp;
-      delP(&tmp);
+      appendInt(filePath, cMSG(imap));
 
 #if defined(ESP_MAIL_SD_FS)
       if (imap->_config->storage.type == esp_mail_file_storage_type_sd)
@@ -4263,7 +4532,7 @@ bool ESP_Mail_Client::handleAttachment(IMAPSession *imap, char *buf, int bufLen,
 
   if (_sdOk || _flashOk)
   {
-    int nOctet = oCount + bufLen + 2;
+    int nOctet = oCount + bufLen + lineEnd;
     if (nOctet > octetLength)
     {
       if (imap->_readCallback)
@@ -4271,7 +4540,7 @@ bool ESP_Mail_Client::handleAttachment(IMAPSession *imap, char *buf, int bufLen,
 
       if (oCount < octetLength)
       {
-        int dLen = nOctet - 2 - octetLength;
+        int dLen = nOctet - lineEnd - octetLength;
         bufLen -= dLen;
         buf[bufLen] = 0;
       }
@@ -4279,15 +4548,31 @@ bool ESP_Mail_Client::handleAttachment(IMAPSession *imap, char *buf, int bufLen,
         return true;
     }
 
-    oCount += bufLen + 2;
+    oCount += bufLen + lineEnd;
 
-    if (strcmpP(cPart(imap)->content_transfer_encoding.c_str(), 0, esp_mail_str_31))
+    if (base64)
     {
-
+      //decode the line in pieces, the decoder keeps the incomplete quantum for the next piece
+      unsigned char out[ESP_MAIL_CLIENT_STREAM_CHUNK_SIZE];
+      int pieceLen = (sizeof(out) / 3 - 1) * 4;
       size_t olen = 0;
-      unsigned char *decoded = decodeBase64((const unsigned char *)buf, bufLen, &olen);
 
-      if (decoded)
+      for (int ofs = 0; ofs < bufLen; ofs += pieceLen)
+      {
+        int len = bufLen - ofs < pieceLen ? bufLen - ofs : pieceLen;
+        size_t n = decodeBase64Chunk(imap->_b64Decoder, (const unsigned char *)buf + ofs, len, out);
+        if (ofs + len >= bufLen && oCount >= octetLength)
+          n += decodeBase64End(imap->_b64Decoder, out + n);
+
+        if (n > 0)
+        {
+          file.write((const uint8_t *)out, n);
+          olen += n;
+        }
+        delay(0);
+      }
+
+      if (olen > 0)
       {
 
         if (!cPart(imap)->sizeProp)
@@ -4296,10 +4581,6 @@ bool ESP_Mail_Client::handleAttachment(IMAPSession *imap, char *buf, int bufLen,
           cHeader(imap)->total_attach_data_size += cPart(imap)->attach_data_size;
         }
 
-        file.write((const uint8_t *)decoded, olen);
-        delay(0);
-        delP(&decoded);
-
         if (imap->_config->enable.download_status)
         {
           int p = 0;
@@ -4362,13 +4643,11 @@ void ESP_Mail_Client::downloadReport(IMAPSession *imap, int progress)
   if (imap->_readCallback && progress % ESP_MAIL_PROGRESS_REPORT_STEP == 0)
   {
     MBSTRING s;
-    char *tmp = intStr(progress);
     appendP(s, esp_mail_str_90, true);
     appendP(s, esp_mail_str_131, false);
     s += cPart(imap)->filename;
     appendP(s, esp_mail_str_91, false);
-    s += tmp;
-    delP(&tmp);
+    appendInt(s, progress);
     appendP(s, esp_mail_str_92, false);
     appendP(s, esp_mail_str_34, false);
     esp_mail_debug_line(s.c_str(), false);
@@ -4381,7 +4660,6 @@ void ESP_Mail_Client::fetchReport(IMAPSession *imap, int progress, bool download
   if (imap->_readCallback && progress % ESP_MAIL_PROGRESS_REPORT_STEP == 0)
   {
     MBSTRING s;
-    char *tmp = intStr(progress);
     if (download)
       appendP(s, esp_mail_str_90, true);
     else
@@ -4392,8 +4670,7 @@ void ESP_Mail_Client::fetchReport(IMAPSession *imap, int progress, bool download
       s += cPart(imap)->filename;
       appendP(s, esp_mail_str_91, false);
     }
-    s += tmp;
-    delP(&tmp);
+    appendInt(s, progress);
     appendP(s, esp_mail_str_92, false);
     appendP(s, esp_mail_str_34, false);
     esp_mail_debug_line(s.c_str(), false);
@@ -4405,14 +4682,12 @@ void ESP_Mail_Client::searchReport(int progress, const char *percent)
 {
   if (progress % ESP_MAIL_PROGRESS_REPORT_STEP == 0)
   {
-    char *tmp = intStr(progress);
     MBSTRING s;
     appendP(s, esp_mail_str_261, true);
-    s += tmp;
+    appendInt(s, progress);
     s += percent;
     appendP(s, esp_mail_str_34, false);
     esp_mail_debug_line(s.c_str(), false);
-    delP(&tmp);
   }
 }
 
@@ -4439,6 +4714,9 @@ void ESP_Mail_Client::decodeText(IMAPSession *imap, char *buf, int bufLen, int &
       delP(&tmp);
       chunkIdx++;
       cPart(imap)->octetLen = octetLength;
+      imap->_b64Decoder = esp_mail_base64_decoder_t();
+      imap->_qpDecoder = esp_mail_qp_decoder_t();
+      imap->_charset = getCharset(cPart(imap)->charset);
 
       if ((rfc822_body_subtype && imap->_config->download.rfc822) || (!rfc822_body_subtype && ((cPart(imap)->msg_type == esp_mail_msg_type_html && imap->_config->download.html) || ((cPart(imap)->msg_type == esp_mail_msg_type_plain || cPart(imap)->msg_type == esp_mail_msg_type_enriched) && imap->_config->download.text))))
         prepareFilePath(imap, filePath, false);
@@ -4484,17 +4762,41 @@ void ESP_Mail_Client::decodeText(IMAPSession *imap, char *buf, int bufLen, int &
       size_t olen = 0;
       char *decoded = nullptr;
       bool newC = true;
-      if (strcmpP(cPart(imap)->content_transfer_encoding.c_str(), 0, esp_mail_str_31))
+      if (strcmpP(cPart(imap)->content_transfer_encoding, 0, esp_mail_str_31))
       {
-        decoded = (char *)decodeBase64((const unsigned char *)buf, bufLen, &olen);
+        //decode the line in pieces, the decoder keeps the incomplete quantum for the next piece
+        unsigned char out[ESP_MAIL_CLIENT_STREAM_CHUNK_SIZE];
+        int pieceLen = (sizeof(out) / 3 - 1) * 4;
+
+        for (int ofs = 0; ofs < bufLen; ofs += pieceLen)
+        {
+          int len = bufLen - ofs < pieceLen ? bufLen - ofs : pieceLen;
+          olen = decodeBase64Chunk(imap->_b64Decoder, (const unsigned char *)buf + ofs, len, out);
+          if (ofs + len >= bufLen && octetCount >= octetLength + 2)
+            olen += decodeBase64End(imap->_b64Decoder, out + olen);
+
+          if (olen > 0)
+            handleDecodedText(imap, (char *)out, olen, false, file, filePath, downloadRequest, octetLength, octetCount, readCount);
+        }
+        return;
       }
-      else if (strcmpP(cPart(imap)->content_transfer_encoding.c_str(), 0, esp_mail_str_278))
+      else if (strcmpP(cPart(imap)->content_transfer_encoding, 0, esp_mail_str_278))
       {
-        decoded = (char *)newP(bufLen + 10);
-        decodeQP(buf, decoded);
-        olen = strlen(decoded);
+        //the soft line breaks and the escapes can be split across lines
+        char out[ESP_MAIL_CLIENT_STREAM_CHUNK_SIZE];
+        int pieceLen = sizeof(out) - 2;
+
+        for (int ofs = 0; ofs < bufLen; ofs += pieceLen)
+        {
+          int len = bufLen - ofs < pieceLen ? bufLen - ofs : pieceLen;
+          olen = decodeQP(imap->_qpDecoder, buf + ofs, len, out);
+
+          if (olen > 0)
+            handleDecodedText(imap, out, olen, false, file, filePath, downloadRequest, octetLength, octetCount, readCount);
+        }
+        return;
       }
-      else if (strcmpP(cPart(imap)->content_transfer_encoding.c_str(), 0, esp_mail_str_29))
+      else if (strcmpP(cPart(imap)->content_transfer_encoding, 0, esp_mail_str_29))
       {
         decoded = decode7Bit(buf);
         olen = strlen(decoded);
@@ -4508,107 +4810,109 @@ void ESP_Mail_Client::decodeText(IMAPSession *imap, char *buf, int bufLen, int &
       }
 
       if (decoded)
-      {
+        handleDecodedText(imap, decoded, olen, newC, file, filePath, downloadRequest, octetLength, octetCount, readCount);
+    }
+  }
+}
 
-        if ((rfc822_body_subtype && imap->_config->enable.rfc822) || (!rfc822_body_subtype && ((cPart(imap)->msg_type == esp_mail_msg_type_html && imap->_config->enable.html) || ((cPart(imap)->msg_type == esp_mail_msg_type_plain || cPart(imap)->msg_type == esp_mail_msg_type_enriched) && imap->_config->enable.text))))
-        {
+void ESP_Mail_Client::handleDecodedText(IMAPSession *imap, char *decoded, size_t olen, bool newC, File &file, MBSTRING &filePath, bool &downloadRequest, int &octetLength, int &octetCount, int &readCount)
+{
+  bool rfc822_body_subtype = cPart(imap)->message_sub_type == esp_mail_imap_message_sub_type_rfc822;
+  bool keep = (rfc822_body_subtype && imap->_config->enable.rfc822) || (!rfc822_body_subtype && ((cPart(imap)->msg_type == esp_mail_msg_type_html && imap->_config->enable.html) || ((cPart(imap)->msg_type == esp_mail_msg_type_plain || cPart(imap)->msg_type == esp_mail_msg_type_enriched) && imap->_config->enable.text)));
 
-          if (getEncodingFromCharset(cPart(imap)->charset.c_str()) == esp_mail_char_decoding_scheme_iso8859_1)
-          {
-            int ilen = olen;
-            int olen2 = (ilen + 1) * 2;
-            unsigned char *tmp = (unsigned char *)newP(olen2);
-            decodeLatin1_UTF8(tmp, &olen2, (unsigned char *)decoded, &ilen);
-            delP(&decoded);
-            olen = olen2;
-            decoded = (char *)tmp;
-          }
-          else if (getEncodingFromCharset(cPart(imap)->charset.c_str()) == esp_mail_char_decoding_scheme_tis620)
-          {
-            char *out = (char *)newP((olen + 1) * 3);
-            delP(&decoded);
-            decodeTIS620_UTF8(out, decoded, olen);
-            olen = strlen(out);
-            decoded = out;
-          }
+  if (keep)
+  {
+    int p = 0;
 
-          int p = 0;
+    if (octetLength > 0)
+      p = 100 * octetCount / octetLength;
 
-          if (octetLength > 0)
-            p = 100 * octetCount / octetLength;
+    if ((p != readCount) && (p <= 100))
+    {
+      readCount = p;
+      if (imap->_readCallback)
+        fetchReport(imap, p, (imap->_config->download.rfc822 && rfc822_body_subtype) || (!rfc822_body_subtype && ((cPart(imap)->msg_type == esp_mail_msg_type_html && imap->_config->download.html) || ((cPart(imap)->msg_type == esp_mail_msg_type_plain || cPart(imap)->msg_type == esp_mail_msg_type_enriched) && imap->_config->download.text))));
+    }
+  }
 
-          if ((p != readCount) && (p <= 100))
-          {
-            readCount = p;
-            if (imap->_readCallback)
-              fetchReport(imap, p, (imap->_config->download.rfc822 && rfc822_body_subtype) || (!rfc822_body_subtype && ((cPart(imap)->msg_type == esp_mail_msg_type_html && imap->_config->download.html) || ((cPart(imap)->msg_type == esp_mail_msg_type_plain || cPart(imap)->msg_type == esp_mail_msg_type_enriched) && imap->_config->download.text))));
-          }
+  if (keep && imap->_charset)
+  {
+    //transcode in pieces, a byte takes at most 3 bytes in UTF-8
+    char out[ESP_MAIL_CLIENT_STREAM_CHUNK_SIZE];
+    size_t pieceLen = sizeof(out) / 3;
 
-          if (cPart(imap)->text.length() < imap->_config->limit.msg_size)
-          {
+    for (size_t ofs = 0; ofs < olen; ofs += pieceLen)
+    {
+      size_t len = olen - ofs < pieceLen ? olen - ofs : pieceLen;
+      storeDecodedText(imap, out, decodeCharset(imap->_charset, decoded + ofs, len, out), keep, file, filePath, downloadRequest);
+    }
+  }
+  else
+    storeDecodedText(imap, decoded, olen, keep, file, filePath, downloadRequest);
 
-            if (cPart(imap)->text.length() + olen < imap->_config->limit.msg_size)
-            {
-              cPart(imap)->textLen += olen;
-              cPart(imap)->text.append(decoded, olen);
-            }
-            else
-            {
-              int d = imap->_config->limit.msg_size - cPart(imap)->text.length();
-              cPart(imap)->textLen += d;
-              if (d > 0)
-                cPart(imap)->text.append(decoded, d);
-            }
-          }
-        }
+  if (newC)
+    delP(&decoded);
+}
 
-        if (filePath.length() > 0)
-        {
-          if (!cPart(imap)->file_open_write)
-          {
-            cPart(imap)->file_open_write = true;
+void ESP_Mail_Client::storeDecodedText(IMAPSession *imap, const char *text, size_t len, bool keep, File &file, MBSTRING &filePath, bool &downloadRequest)
+{
+  if (keep && cPart(imap)->text.length() < imap->_config->limit.msg_size)
+  {
 
-            if (_sdOk || _flashOk)
-            {
-              downloadRequest = true;
+    if (cPart(imap)->text.length() + len < imap->_config->limit.msg_size)
+    {
+      cPart(imap)->textLen += len;
+      cPart(imap)->text.append(text, len);
+    }
+    else
+    {
+      int d = imap->_config->limit.msg_size - cPart(imap)->text.length();
+      cPart(imap)->textLen += d;
+      if (d > 0)
+        cPart(imap)->text.append(text, d);
+    }
+  }
 
-              if (imap->_config->storage.type == esp_mail_file_storage_type_sd)
-              {
+  if (filePath.length() > 0)
+  {
+    if (!cPart(imap)->file_open_write)
+    {
+      cPart(imap)->file_open_write = true;
+
+      if (_sdOk || _flashOk)
+      {
+        downloadRequest = true;
+
+        if (imap->_config->storage.type == esp_mail_file_storage_type_sd)
+        {
 #if defined(ESP_MAIL_SD_FS)
-                file = ESP_MAIL_SD_FS.open(filePath.c_str(), FILE_WRITE);
+          file = ESP_MAIL_SD_FS.open(filePath.c_str(), FILE_WRITE);
 #endif
-              }
-              else if (imap->_config->storage.type == esp_mail_file_storage_type_flash)
-              {
+        }
+        else if (imap->_config->storage.type == esp_mail_file_storage_type_flash)
+        {
 #if defined(ESP_MAIL_FLASH_FS)
 #if defined(ESP32)
-                file = ESP_MAIL_FLASH_FS.open(filePath.c_str(), FILE_WRITE);
+          file = ESP_MAIL_FLASH_FS.open(filePath.c_str(), FILE_WRITE);
 #elif defined(ESP8266)
-                file = ESP_MAIL_FLASH_FS.open(filePath.c_str(), "w");
+          file = ESP_MAIL_FLASH_FS.open(filePath.c_str(), "w");
 #endif
 #endif
-              }
-            }
-          }
-
-          if (_sdOk || _flashOk)
-            file.write((const uint8_t *)decoded, olen);
         }
-
-        if (newC)
-          delP(&decoded);
       }
     }
+
+    if (_sdOk || _flashOk)
+      file.write((const uint8_t *)text, len);
   }
 }
+
 void ESP_Mail_Client::prepareFilePath(IMAPSession *imap, MBSTRING &filePath, bool header)
 {
   bool rfc822_body_subtype = cPart(imap)->message_sub_type == esp_mail_imap_message_sub_type_rfc822;
   MBSTRING fpath = imap->_config->storage.saved_path;
   appendP(fpath, esp_mail_str_202, false);
-  char *tmp = intStr(cMSG(imap));
-  fpath += tmp;
-  delP(&tmp);
+  appendInt(fpath, cMSG(imap));
 
   if (imap->_config->storage.type == esp_mail_file_storage_type_sd)
     if (!ESP_MAIL_SD_FS.exists(fpath.c_str()))
@@ -4634,9 +4938,7 @@ void ESP_Mail_Client::prepareFilePath(IMAPSession *imap, MBSTRING &filePath, boo
 
       if (cPart(imap)->rfc822_msg_Idx > 0)
       {
-        char *tmp = intStr(cPart(imap)->rfc822_msg_Idx);
-        fpath += tmp;
-        delP(&tmp);
+        appendInt(fpath, cPart(imap)->rfc822_msg_Idx);
       }
 
       if (cPart(imap)->msg_type == esp_mail_msg_type_plain || cPart(imap)->msg_type == esp_mail_msg_type_enriched)
@@ -4658,6 +4960,7 @@ IMAPSession::IMAPSession()
 IMAPSession::~IMAPSession()
 {
   empty();
+  MailClient.clearReader(_reader);
 #if defined(ESP32) || defined(ESP8266)
   _caCert.reset();
   _caCert = nullptr;
@@ -4713,7 +5016,10 @@ bool IMAPSession::connect(ESP_Mail_Session *sesssion, IMAP_Config *config)
 
 #endif
 
-  return MailClient.imapAuth(this);
+  MailClient.beginAllocStats();
+  bool ret = MailClient.imapAuth(this);
+  MailClient.endAllocStats(_debug);
+  return ret;
 }
 
 void IMAPSession::debug(int level)
@@ -4828,6 +5134,15 @@ bool IMAPSession::closeFolder(const char *folderName)
   return closeMailbox();
 }
 
+bool IMAPSession::listen()
+{
+  MailClient.beginAllocStats();
+  bool ret = mListen(false);
+  //listen is polled in the loop, report at the higher debug level only
+  MailClient.endAllocStats(_debugLevel > esp_mail_debug_level_1);
+  return ret;
+}
+
 bool IMAPSession::mListen(bool recon)
 {
   //no folder opened or IDLE was not supported
@@ -5004,20 +5319,20 @@ struct esp_mail_imap_msg_list_t IMAPSession::data()
 
     itm.UID = _headers[i].message_uid;
     itm.msgNo = _headers[i].message_no;
-    itm.ID = _headers[i].header_fields.messageID.c_str();
-    itm.from = _headers[i].header_fields.from.c_str();
-    itm.sender = _headers[i].header_fields.sender.c_str();
-    itm.to = _headers[i].header_fields.to.c_str();
-    itm.cc = _headers[i].header_fields.cc.c_str();
-    itm.subject = _headers[i].header_fields.subject.c_str();
-    itm.date = _headers[i].header_fields.date.c_str();
-    itm.return_path = _headers[i].header_fields.return_path.c_str();
-    itm.reply_to = _headers[i].header_fields.reply_to.c_str();
-    itm.in_reply_to = _headers[i].header_fields.in_reply_to.c_str();
-    itm.references = _headers[i].header_fields.references.c_str();
-    itm.comments = _headers[i].header_fields.comments.c_str();
-    itm.keywords = _headers[i].header_fields.keywords.c_str();
-    itm.flags = _headers[i].flags.c_str();
+    itm.ID = _headers[i].header_fields.get(esp_mail_rfc822_header_field_messageID);
+    itm.from = _headers[i].header_fields.get(esp_mail_rfc822_header_field_from);
+    itm.sender = _headers[i].header_fields.get(esp_mail_rfc822_header_field_sender);
+    itm.to = _headers[i].header_fields.get(esp_mail_rfc822_header_field_to);
+    itm.cc = _headers[i].header_fields.get(esp_mail_rfc822_header_field_cc);
+    itm.subject = _headers[i].header_fields.get(esp_mail_rfc822_header_field_subject);
+    itm.date = _headers[i].header_fields.get(esp_mail_rfc822_header_field_date);
+    itm.return_path = _headers[i].header_fields.get(esp_mail_rfc822_header_field_return_path);
+    itm.reply_to = _headers[i].header_fields.get(esp_mail_rfc822_header_field_reply_to);
+    itm.in_reply_to = _headers[i].header_fields.get(esp_mail_rfc822_header_field_in_reply_to);
+    itm.references = _headers[i].header_fields.get(esp_mail_rfc822_header_field_references);
+    itm.comments = _headers[i].header_fields.get(esp_mail_rfc822_header_field_comments);
+    itm.keywords = _headers[i].header_fields.get(esp_mail_rfc822_header_field_keywords);
+    itm.flags = _headers[i].flags;
     itm.acceptLang = _headers[i].accept_language.c_str();
     itm.contentLang = _headers[i].content_language.c_str();
     itm.hasAttachment = _headers[i].hasAttachment;
@@ -5027,7 +5342,7 @@ struct esp_mail_imap_msg_list_t IMAPSession::data()
 
     getRFC822Messages(i, itm);
 
-    ret.msgItems.push_back(itm);
+    ret.msgItems.push_back(std::move(itm));
   }
 
   return ret;
@@ -5068,24 +5383,24 @@ void IMAPSession::getMessages(uint16_t messageIndex, struct esp_mail_imap_msg_it
             if (_headers[messageIndex].part_headers[i].msg_type == esp_mail_msg_type_plain || _headers[messageIndex].part_headers[i].msg_type == esp_mail_msg_type_enriched)
             {
               msg.text.content = _headers[messageIndex].part_headers[i].text.c_str();
-              msg.text.charSet = _headers[messageIndex].part_headers[i].charset.c_str();
-              msg.text.content_type = _headers[messageIndex].part_headers[i].content_type.c_str();
-              msg.text.transfer_encoding = _headers[messageIndex].part_headers[i].content_transfer_encoding.c_str();
+              msg.text.charSet = _headers[messageIndex].part_headers[i].charset;
+              msg.text.content_type = _headers[messageIndex].part_headers[i].content_type;
+              msg.text.transfer_encoding = _headers[messageIndex].part_headers[i].content_transfer_encoding;
             }
 
             if (_headers[messageIndex].part_headers[i].msg_type == esp_mail_msg_type_html)
             {
               msg.html.content = _headers[messageIndex].part_headers[i].text.c_str();
-              msg.html.charSet = _headers[messageIndex].part_headers[i].charset.c_str();
-              msg.html.content_type = _headers[messageIndex].part_headers[i].content_type.c_str();
-              msg.html.transfer_encoding = _headers[messageIndex].part_headers[i].content_transfer_encoding.c_str();
+              msg.html.charSet = _headers[messageIndex].part_headers[i].charset;
+              msg.html.content_type = _headers[messageIndex].part_headers[i].content_type;
+              msg.html.transfer_encoding = _headers[messageIndex].part_headers[i].content_transfer_encoding;
             }
           }
           else
           {
             struct esp_mail_attachment_info_t att;
             att.filename = _headers[messageIndex].part_headers[i].filename.c_str();
-            att.mime = _headers[messageIndex].part_headers[i].content_type.c_str();
+            att.mime = _headers[messageIndex].part_headers[i].content_type;
             att.name = _headers[messageIndex].part_headers[i].name.c_str();
             att.size = _headers[messageIndex].part_headers[i].attach_data_size;
             att.creationDate = _headers[messageIndex].part_headers[i].creation_date.c_str();
@@ -5115,25 +5430,28 @@ void IMAPSession::getRFC822Messages(uint16_t messageIndex, struct esp_mail_imap_
           if (_headers[messageIndex].part_headers[i].rfc822_part)
           {
             if (partIdx > 0)
-              msg.rfc822.push_back(*_rfc822);
+            {
+              msg.rfc822.push_back(std::move(*_rfc822));
+              delete _rfc822;
+            }
             cIdx = i;
             partIdx++;
             _rfc822 = new IMAP_MSG_Item();
 
-            _rfc822->from = _headers[messageIndex].part_headers[i].rfc822_header.from.c_str();
-            _rfc822->sender = _headers[messageIndex].part_headers[i].rfc822_header.sender.c_str();
-            _rfc822->to = _headers[messageIndex].part_headers[i].rfc822_header.to.c_str();
-            _rfc822->cc = _headers[messageIndex].part_headers[i].rfc822_header.cc.c_str();
-            _rfc822->return_path = _headers[messageIndex].part_headers[i].rfc822_header.return_path.c_str();
-            _rfc822->reply_to = _headers[messageIndex].part_headers[i].rfc822_header.reply_to.c_str();
-            _rfc822->subject = _headers[messageIndex].part_headers[i].rfc822_header.subject.c_str();
-            _rfc822->comments = _headers[messageIndex].part_headers[i].rfc822_header.comments.c_str();
-            _rfc822->keywords = _headers[messageIndex].part_headers[i].rfc822_header.keywords.c_str();
-            _rfc822->in_reply_to = _headers[messageIndex].part_headers[i].rfc822_header.in_reply_to.c_str();
-            _rfc822->references = _headers[messageIndex].part_headers[i].rfc822_header.references.c_str();
-            _rfc822->date = _headers[messageIndex].part_headers[i].rfc822_header.date.c_str();
-            _rfc822->ID = _headers[messageIndex].part_headers[i].rfc822_header.messageID.c_str();
-            _rfc822->flags = _headers[messageIndex].part_headers[i].rfc822_header.flags.c_str();
+            _rfc822->from = _headers[messageIndex].part_headers[i].rfc822_header.get(esp_mail_rfc822_header_field_from);
+            _rfc822->sender = _headers[messageIndex].part_headers[i].rfc822_header.get(esp_mail_rfc822_header_field_sender);
+            _rfc822->to = _headers[messageIndex].part_headers[i].rfc822_header.get(esp_mail_rfc822_header_field_to);
+            _rfc822->cc = _headers[messageIndex].part_headers[i].rfc822_header.get(esp_mail_rfc822_header_field_cc);
+            _rfc822->return_path = _headers[messageIndex].part_headers[i].rfc822_header.get(esp_mail_rfc822_header_field_return_path);
+            _rfc822->reply_to = _headers[messageIndex].part_headers[i].rfc822_header.get(esp_mail_rfc822_header_field_reply_to);
+            _rfc822->subject = _headers[messageIndex].part_headers[i].rfc822_header.get(esp_mail_rfc822_header_field_subject);
+            _rfc822->comments = _headers[messageIndex].part_headers[i].rfc822_header.get(esp_mail_rfc822_header_field_comments);
+            _rfc822->keywords = _headers[messageIndex].part_headers[i].rfc822_header.get(esp_mail_rfc822_header_field_keywords);
+            _rfc822->in_reply_to = _headers[messageIndex].part_headers[i].rfc822_header.get(esp_mail_rfc822_header_field_in_reply_to);
+            _rfc822->references = _headers[messageIndex].part_headers[i].rfc822_header.get(esp_mail_rfc822_header_field_references);
+            _rfc822->date = _headers[messageIndex].part_headers[i].rfc822_header.get(esp_mail_rfc822_header_field_date);
+            _rfc822->ID = _headers[messageIndex].part_headers[i].rfc822_header.get(esp_mail_rfc822_header_field_messageID);
+            _rfc822->flags = _headers[messageIndex].part_headers[i].rfc822_header.get(esp_mail_rfc822_header_field_flags);
             _rfc822->text.charSet = "";
             _rfc822->text.content_type = "";
             _rfc822->text.transfer_encoding = "";
@@ -5149,24 +5467,24 @@ void IMAPSession::getRFC822Messages(uint16_t messageIndex, struct esp_mail_imap_
               {
                 if (_headers[messageIndex].part_headers[i].msg_type == esp_mail_msg_type_plain || _headers[messageIndex].part_headers[i].msg_type == esp_mail_msg_type_enriched)
                 {
-                  _rfc822->text.charSet = _headers[messageIndex].part_headers[i].charset.c_str();
-                  _rfc822->text.content_type = _headers[messageIndex].part_headers[i].content_type.c_str();
+                  _rfc822->text.charSet = _headers[messageIndex].part_headers[i].charset;
+                  _rfc822->text.content_type = _headers[messageIndex].part_headers[i].content_type;
                   _rfc822->text.content = _headers[messageIndex].part_headers[i].text.c_str();
-                  _rfc822->text.transfer_encoding = _headers[messageIndex].part_headers[i].content_transfer_encoding.c_str();
+                  _rfc822->text.transfer_encoding = _headers[messageIndex].part_headers[i].content_transfer_encoding;
                 }
                 if (_headers[messageIndex].part_headers[i].msg_type == esp_mail_msg_type_html)
                 {
-                  _rfc822->html.charSet = _headers[messageIndex].part_headers[i].charset.c_str();
-                  _rfc822->html.content_type = _headers[messageIndex].part_headers[i].content_type.c_str();
+                  _rfc822->html.charSet = _headers[messageIndex].part_headers[i].charset;
+                  _rfc822->html.content_type = _headers[messageIndex].part_headers[i].content_type;
                   _rfc822->html.content = _headers[messageIndex].part_headers[i].text.c_str();
-                  _rfc822->html.transfer_encoding = _headers[messageIndex].part_headers[i].content_transfer_encoding.c_str();
+                  _rfc822->html.transfer_encoding = _headers[messageIndex].part_headers[i].content_transfer_encoding;
                 }
               }
               else
               {
                 struct esp_mail_attachment_info_t att;
                 att.filename = _headers[messageIndex].part_headers[i].filename.c_str();
-                att.mime = _headers[messageIndex].part_headers[i].content_type.c_str();
+                att.mime = _headers[messageIndex].part_headers[i].content_type;
                 att.name = _headers[messageIndex].part_headers[i].name.c_str();
                 att.size = _headers[messageIndex].part_headers[i].attach_data_size;
                 att.creationDate = _headers[messageIndex].part_headers[i].creation_date.c_str();
@@ -5179,7 +5497,10 @@ void IMAPSession::getRFC822Messages(uint16_t messageIndex, struct esp_mail_imap_
       }
 
       if ((int)msg.rfc822.size() < partIdx && _rfc822 != nullptr)
-        msg.rfc822.push_back(*_rfc822);
+        msg.rfc822.push_back(std::move(*_rfc822));
+
+      if (_rfc822)
+        delete _rfc822;
     }
   }
 }
@@ -5362,9 +5683,7 @@ int IMAPSession::getUID(int msgNum)
 
   MBSTRING cmd;
   MailClient.appendP(cmd, esp_mail_str_143, true);
-  char *tmp = MailClient.intStr(msgNum);
-  cmd += tmp;
-  MailClient.delP(&tmp);
+  MailClient.appendInt(cmd, msgNum);
   MailClient.appendP(cmd, esp_mail_str_138, false);
 
   MBSTRING s;
@@ -5388,7 +5707,8 @@ int IMAPSession::getUID(int msgNum)
   if (_readCallback || _debug)
   {
 
-    char *num = MailClient.intStr(_uid_tmp);
+    char num[12];
+    MailClient.intToStr(_uid_tmp, num);
 
     if (_readCallback)
     {
@@ -5403,8 +5723,6 @@ int IMAPSession::getUID(int msgNum)
       s += num;
       esp_mail_debug(s.c_str());
     }
-
-    MailClient.delP(&num);
   }
 
   return _uid_tmp;
@@ -5418,9 +5736,7 @@ const char *IMAPSession::getFlags(int msgNum)
 
   MBSTRING cmd;
   MailClient.appendP(cmd, esp_mail_str_143, true);
-  char *tmp = MailClient.intStr(msgNum);
-  cmd += tmp;
-  MailClient.delP(&tmp);
+  MailClient.appendInt(cmd, msgNum);
   MailClient.appendP(cmd, esp_mail_str_273, false);
 
   MBSTRING s;
@@ -5497,15 +5813,12 @@ bool IMAPSession::deleteMessages(MessageList *toDelete, bool expunge)
     }
 
     MBSTRING cmd;
-    char *tmp = NULL;
     MailClient.appendP(cmd, esp_mail_str_249, true);
     for (size_t i = 0; i < toDelete->_list.size(); i++)
     {
       if (i > 0)
         MailClient.appendP(cmd, esp_mail_str_263, false);
-      tmp = MailClient.intStr(toDelete->_list[i]);
-      cmd += tmp;
-      MailClient.delP(&tmp);
+      MailClient.appendInt(cmd, toDelete->_list[i]);
     }
     MailClient.appendP(cmd, esp_mail_str_315, false);
 
@@ -5547,15 +5860,12 @@ bool IMAPSession::copyMessages(MessageList *toCopy, const char *dest)
     }
 
     MBSTRING cmd;
-    char *tmp = nullptr;
     MailClient.appendP(cmd, esp_mail_str_319, true);
     for (size_t i = 0; i < toCopy->_list.size(); i++)
     {
       if (i > 0)
         MailClient.appendP(cmd, esp_mail_str_263, false);
-      tmp = MailClient.intStr(toCopy->_list[i]);
-      cmd += tmp;
-      MailClient.delP(&tmp);
+      MailClient.appendInt(cmd, toCopy->_list[i]);
     }
     MailClient.appendP(cmd, esp_mail_str_131, false);
     cmd += dest;
@@ -5577,6 +5887,20 @@ void IMAPSession::empty()
   clearMessageData();
 }
 
+IMAP_Command_Stats IMAPSession::commandStats(esp_mail_imap_command cmd)
+{
+  IMAP_Command_Stats stats;
+  if (cmd < esp_mail_imap_cmd_max)
+    return _cmdStats[cmd];
+  return stats;
+}
+
+void IMAPSession::resetCommandStats()
+{
+  for (int i = 0; i < esp_mail_imap_cmd_max; i++)
+    _cmdStats[i] = esp_mail_imap_command_stats_t();
+}
+
 void IMAPSession::clearMessageData()
 {
   for (size_t i = 0; i < _headers.size(); i++)
@@ -5585,6 +5909,7 @@ void IMAPSession::clearMessageData()
     std::vector<struct esp_mail_message_part_info_t>().swap(_headers[i].part_headers);
   }
   std::vector<struct esp_mail_message_header_t>().swap(_headers);
+  MailClient.clearInternStr(this);
   std::vector<uint32_t>().swap(_msgUID);
   _folders.clear();
   _mbif._flags.clear();
@@ -5667,6 +5992,8 @@ bool ESP_Mail_Client::smtpAuth(SMTPSession *smtp)
   smtp->_secure = true;
   bool secureMode = true;
 
+  clearSMTPPhases(smtp, esp_mail_smtp_phase_connect, esp_mail_smtp_phase_auth);
+
   MBSTRING s;
 
 #if defined(ESP32)
@@ -5725,11 +6052,9 @@ bool ESP_Mail_Client::smtpAuth(SMTPSession *smtp)
     appendP(s, esp_mail_str_211, false);
     s += smtp->_sesson_cfg->server.host_name;
     esp_mail_debug(s.c_str());
-    char *tmp = intStr(smtp->_sesson_cfg->server.port);
     appendP(s, esp_mail_str_261, true);
     appendP(s, esp_mail_str_201, false);
-    s += tmp;
-    delP(&tmp);
+    appendInt(s, smtp->_sesson_cfg->server.port);
     esp_mail_debug(s.c_str());
   }
 #if defined(ESP32)
@@ -5741,6 +6066,10 @@ bool ESP_Mail_Client::smtpAuth(SMTPSession *smtp)
 
   ethDNSWorkAround(smtp->_sesson_cfg);
 
+  clearReader(smtp->_reader);
+
+  smtpPhase(smtp, esp_mail_smtp_phase_connect);
+
   if (!smtp->tcpClient.connect(secureMode, smtp->_sesson_cfg->certificate.verify))
     return handleSMTPError(smtp, SMTP_STATUS_SERVER_CONNECT_FAILED);
 
@@ -5765,12 +6094,16 @@ bool ESP_Mail_Client::smtpAuth(SMTPSession *smtp)
 
   smtp->_smtp_cmd = esp_mail_smtp_command::esp_mail_smtp_cmd_initial_state;
 
+  smtpPhase(smtp, esp_mail_smtp_phase_greeting);
+
   //expected status code 220 for ready to service
   if (!handleSMTPResponse(smtp, esp_mail_smtp_status_code_220, SMTP_STATUS_SMTP_GREETING_GET_RESPONSE_FAILED))
     return false;
 
 init:
 
+  smtpPhase(smtp, esp_mail_smtp_phase_ehlo);
+
   //Sending greeting hello response
   if (smtp->_sendCallback)
   {
@@ -5829,6 +6162,7 @@ init:
     //expected status code 250 for complete the request
     //some server returns 220 to restart to initial state
     smtp->_smtp_cmd = esp_mail_smtp_command::esp_mail_smtp_cmd_start_tls;
+    smtpPhase(smtp, esp_mail_smtp_phase_start_tls);
     smtpSendP(smtp, esp_mail_str_311, false);
     if (!handleSMTPResponse(smtp, esp_mail_smtp_status_code_250, SMTP_STATUS_SMTP_GREETING_SEND_ACK_FAILED))
       return false;
@@ -5840,6 +6174,9 @@ init:
 
     //connect in secure mode
     //do ssl handshake
+    //discard any plain text data buffered before the handshake
+    clearReader(smtp->_reader);
+    smtpPhase(smtp, esp_mail_smtp_phase_tls_handshake);
 #if defined(ARDUINO_ARCH_SAMD)
     if (!smtp->tcpClient.connectSSL(smtp->_sesson_cfg->certificate.verify))
       return handleSMTPError(smtp, MAIL_CLIENT_ERROR_SSL_TLS_STRUCTURE_SETUP);
@@ -5865,6 +6202,8 @@ init:
 
   if (xoauth_auth || login_auth || plain_auth)
   {
+    smtpPhase(smtp, esp_mail_smtp_phase_auth);
+
     if (smtp->_sendCallback)
     {
       smtpCB(smtp, "", false);
@@ -5998,10 +6337,14 @@ bool ESP_Mail_Client::setSendingResult(SMTPSession *smtp, SMTP_Message *msg, boo
   else
     smtp->_sentFailedCount++;
 
+  smtpPhase(smtp, esp_mail_smtp_phase_max);
+
   if (smtp->_sendCallback)
   {
     SMTP_Result status;
     status.completed = result;
+    for (int i = 0; i < esp_mail_smtp_phase_max; i++)
+      status.phases[i] = smtp->_phases[i];
 #if defined(ARDUINO_ARCH_SAMD)
     unsigned long ts = WiFi.getTime();
     status.timestamp = ts;
@@ -6038,7 +6381,10 @@ bool ESP_Mail_Client::sendMail(SMTPSession *smtp, SMTP_Message *msg, bool closeS
       msg->_rfc822[i].type |= esp_mail_msg_type_plain;
   }
 
-  return mSendMail(smtp, msg, closeSession);
+  beginAllocStats();
+  bool ret = mSendMail(smtp, msg, closeSession);
+  endAllocStats(smtp->_debug);
+  return ret;
 }
 
 size_t ESP_Mail_Client::numAtt(SMTPSession *smtp, esp_mail_attach_type type, SMTP_Message *msg)
@@ -6085,6 +6431,8 @@ bool ESP_Mail_Client::mSendMail(SMTPSession *smtp, SMTP_Message *msg, bool close
   smtp->_smtpStatus.text.clear();
   bool rfc822MSG = false;
 
+  clearSMTPPhases(smtp, esp_mail_smtp_phase_mail_from, esp_mail_smtp_phase_end);
+
   if (!checkEmail(smtp, msg))
     return false;
 
@@ -6094,7 +6442,9 @@ bool ESP_Mail_Client::mSendMail(SMTPSession *smtp, SMTP_Message *msg, bool close
   //new session
   if (!smtp->_tcpConnected)
   {
-    if (!smtpAuth(smtp))
+    bool ret = smtpAuth(smtp);
+    smtpPhase(smtp, esp_mail_smtp_phase_max);
+    if (!ret)
     {
       closeTCPSession(smtp);
       return setSendingResult(smtp, msg, false);
@@ -6139,10 +6489,8 @@ bool ESP_Mail_Client::mSendMail(SMTPSession *smtp, SMTP_Message *msg, bool close
 
   if (msg->priority >= esp_mail_smtp_priority_high && msg->priority <= esp_mail_smtp_priority_low)
   {
-    char *tmp = intStr(msg->priority);
     appendP(buf2, esp_mail_str_17, true);
-    buf2 += tmp;
-    delP(&tmp);
+    appendInt(buf2, msg->priority);
     appendP(buf2, esp_mail_str_34, false);
 
     if (msg->priority == esp_mail_smtp_priority_high)
@@ -6181,6 +6529,8 @@ bool ESP_Mail_Client::mSendMail(SMTPSession *smtp, SMTP_Message *msg, bool close
   if (smtp->_send_capability.binaryMIME && smtp->_send_capability.chunking && msg->enable.chunking && (msg->text._int.binary || msg->html._int.binary))
     appendP(buf, esp_mail_str_104, false);
 
+  smtpPhase(smtp, esp_mail_smtp_phase_mail_from);
+
   if (smtpSend(smtp, buf.c_str(), true) == ESP_MAIL_CLIENT_TRANSFER_DATA_FAILED)
     return setSendingResult(smtp, msg, false);
 
@@ -6220,6 +6570,7 @@ bool ESP_Mail_Client::mSendMail(SMTPSession *smtp, SMTP_Message *msg, bool close
 
     buf.clear();
     //only address
+    smtpPhase(smtp, esp_mail_smtp_phase_rcpt);
     appendP(buf, esp_mail_str_9, false);
     appendP(buf, esp_mail_str_14, false);
     buf += msg->_rcp[i].email;
@@ -6286,6 +6637,7 @@ bool ESP_Mail_Client::mSendMail(SMTPSession *smtp, SMTP_Message *msg, bool close
 
     buf.clear();
 
+    smtpPhase(smtp, esp_mail_smtp_phase_rcpt);
     appendP(buf, esp_mail_str_9, false);
     appendP(buf, esp_mail_str_14, false);
     buf += msg->_cc[i].email;
@@ -6301,6 +6653,7 @@ bool ESP_Mail_Client::mSendMail(SMTPSession *smtp, SMTP_Message *msg, bool close
 
   for (uint8_t i = 0; i < msg->_bcc.size(); i++)
   {
+    smtpPhase(smtp, esp_mail_smtp_phase_rcpt);
     appendP(buf, esp_mail_str_9, true);
     appendP(buf, esp_mail_str_14, false);
     buf += msg->_bcc[i].email;
@@ -6321,6 +6674,8 @@ bool ESP_Mail_Client::mSendMail(SMTPSession *smtp, SMTP_Message *msg, bool close
   if (smtp->_debug)
     debugInfoP(esp_mail_str_243);
 
+  smtpPhase(smtp, esp_mail_smtp_phase_data);
+
   if (smtp->_send_capability.chunking && msg->enable.chunking)
   {
     smtp->_chunkedEnable = true;
@@ -6515,6 +6870,8 @@ bool ESP_Mail_Client::sendMSGData(SMTPSession *smtp, SMTP_Message *msg, bool clo
     if (smtp->_debug)
       debugInfoP(esp_mail_str_304);
 
+    smtpPhase(smtp, esp_mail_smtp_phase_end);
+
     if (smtp->_chunkedEnable)
     {
 
@@ -6552,6 +6909,7 @@ bool ESP_Mail_Client::sendRFC822Msg(SMTPSession *smtp, SMTP_Message *msg, const
   MBSTRING buf;
   for (uint8_t i = 0; i < msg->_rfc822.size(); i++)
   {
+    smtpPhase(smtp, esp_mail_smtp_phase_attachment);
     buf.clear();
     getRFC822PartHeader(smtp, buf, boundary);
 
@@ -6759,11 +7117,9 @@ bool ESP_Mail_Client::bdat(SMTPSession *smtp, SMTP_Message *msg, int len, bool l
 
   MBSTRING bdat;
   appendP(bdat, esp_mail_str_106, true);
-  char *tmp = intStr(len);
-  bdat += tmp;
+  appendInt(bdat, len);
   if (last)
     appendP(bdat, esp_mail_str_173, false);
-  delP(&tmp);
   if (smtpSend(smtp, bdat.c_str(), true) == ESP_MAIL_CLIENT_TRANSFER_DATA_FAILED)
     return setSendingResult(smtp, msg, false);
 
@@ -6990,6 +7346,8 @@ bool ESP_Mail_Client::sendAttachments(SMTPSession *smtp, SMTP_Message *msg, cons
 
     if (att->_int.att_type == esp_mail_att_type_attachment)
     {
+      smtpPhase(smtp, esp_mail_smtp_phase_attachment);
+
       appendP(s, esp_mail_str_261, true);
       s += att->descr.filename;
 
@@ -7457,6 +7815,8 @@ size_t ESP_Mail_Client::smtpSendP(SMTPSession *smtp, PGM_P v, bool newline)
     len = 0;
   }
 
+  smtp->_sentBytes += len;
+
   delP(&tmp);
 
   return len;
@@ -7503,6 +7863,8 @@ size_t ESP_Mail_Client::smtpSend(SMTPSession *smtp, const char *data, bool newli
     len = 0;
   }
 
+  smtp->_sentBytes += len;
+
   return len;
 }
 
@@ -7526,7 +7888,8 @@ size_t ESP_Mail_Client::smtpSend(SMTPSession *smtp, int data, bool newline)
     return 0;
   }
 
-  char *tmp = intStr(data);
+  char tmp[12];
+  size_t tmpLen = intToStr(data, tmp);
   size_t len = 0;
 
   if (newline)
@@ -7542,13 +7905,13 @@ size_t ESP_Mail_Client::smtpSend(SMTPSession *smtp, int data, bool newline)
     len = smtp->tcpClient.stream()->print(tmp);
   }
 
-  if (len != strlen(tmp) && len != strlen(tmp) + 2)
+  if (len != tmpLen && len != tmpLen + 2)
   {
     errorStatusCB(smtp, MAIL_CLIENT_ERROR_SERVER_CONNECTION_FAILED);
     len = 0;
   }
 
-  delP(&tmp);
+  smtp->_sentBytes += len;
 
   return len;
 }
@@ -7583,6 +7946,8 @@ size_t ESP_Mail_Client::smtpSend(SMTPSession *smtp, uint8_t *data, size_t size)
     len = 0;
   }
 
+  smtp->_sentBytes += len;
+
   return len;
 }
 
@@ -7597,6 +7962,33 @@ bool ESP_Mail_Client::handleSMTPError(SMTPSession *smtp, int err, bool ret)
   return ret;
 }
 
+void ESP_Mail_Client::smtpPhase(SMTPSession *smtp, int phase)
+{
+  unsigned long ms = millis();
+
+  //close the current phase
+  if (smtp->_phase < esp_mail_smtp_phase_max)
+  {
+    smtp->_phases[smtp->_phase].time += ms - smtp->_phaseMillis;
+    smtp->_phases[smtp->_phase].bytes += smtp->_sentBytes - smtp->_phaseBytes;
+  }
+
+  smtp->_phase = phase;
+
+  if (phase < esp_mail_smtp_phase_max)
+  {
+    smtp->_phases[phase].count++;
+    smtp->_phaseMillis = ms;
+    smtp->_phaseBytes = smtp->_sentBytes;
+  }
+}
+
+void ESP_Mail_Client::clearSMTPPhases(SMTPSession *smtp, int first, int last)
+{
+  for (int i = first; i <= last; i++)
+    smtp->_phases[i] = esp_mail_smtp_phase_info_t();
+}
+
 bool ESP_Mail_Client::sendPartText(SMTPSession *smtp, SMTP_Message *msg, uint8_t type, const char *boundary)
 {
   MBSTRING header;
@@ -7781,8 +8173,8 @@ bool ESP_Mail_Client::sendPartText(SMTPSession *smtp, SMTP_Message *msg, uint8_t
     if (!sendFileBody(smtp, msg, type))
       return false;
   }
-  else
-    encodingText(smtp, msg, type, header);
+  else if (!encodingText(smtp, msg, type, header))
+    return false;
 
   appendP(header, esp_mail_str_34, false);
 
@@ -8045,125 +8437,222 @@ bool ESP_Mail_Client::sendFileBody(SMTPSession *smtp, SMTP_Message *msg, uint8_t
     }
   }
 
-  return false;
+  return false;
+}
+
+bool ESP_Mail_Client::encodingText(SMTPSession *smtp, SMTP_Message *msg, uint8_t type, MBSTRING &content)
+{
+  if (type == esp_mail_msg_type_plain || type == esp_mail_msg_type_enriched)
+  {
+    MBSTRING s;
+
+    if (msg->text.flowed)
+      formatFlowedText(msg->text.content, s);
+    else
+      s = msg->text.content;
+
+    if (strlen(msg->text.transfer_encoding) > 0)
+    {
+      if (strcmp(msg->text.transfer_encoding, Content_Transfer_Encoding::enc_base64) == 0)
+        content += encodeBase64Str((const unsigned char *)s.c_str(), s.length());
+      else if (strcmp(msg->text.transfer_encoding, Content_Transfer_Encoding::enc_qp) == 0)
+        return sendQP(smtp, msg, content, s.c_str(), s.length());
+      else
+        content += s;
+    }
+    else
+      content += s;
+  }
+  else if (type == esp_mail_message_type::esp_mail_msg_type_html)
+  {
+    MBSTRING s;
+    replaceInlineCID(msg, msg->html.content, s);
+
+    if (strlen(msg->html.transfer_encoding) > 0)
+    {
+      if (strcmp(msg->html.transfer_encoding, Content_Transfer_Encoding::enc_base64) == 0)
+        content += encodeBase64Str((const unsigned char *)s.c_str(), s.length());
+      else if (strcmp(msg->html.transfer_encoding, Content_Transfer_Encoding::enc_qp) == 0)
+        return sendQP(smtp, msg, content, s.c_str(), s.length());
+      else
+        content += s;
+    }
+    else
+      content += s;
+    MBSTRING().swap(s);
+  }
+
+  return true;
 }
 
-void ESP_Mail_Client::encodingText(SMTPSession *smtp, SMTP_Message *msg, uint8_t type, MBSTRING &content)
+size_t ESP_Mail_Client::encodeQP(struct esp_mail_qp_encoder_t &encoder, const char *src, size_t len, char *out, size_t outLen, size_t &olen)
 {
-  if (type == esp_mail_msg_type_plain || type == esp_mail_msg_type_enriched)
+  size_t i = 0;
+  olen = 0;
+
+  //each input byte takes at most 6 output bytes, the soft line break and the escaped byte
+  while (i < len && olen + 6 <= outLen)
   {
-    MBSTRING s = msg->text.content;
+    unsigned char c = src[i];
 
-    if (msg->text.flowed)
-      formatFlowedText(s);
+    if (encoder.col >= 73 && c != 10 && c != 13)
+    {
+      out[olen++] = '=';
+      out[olen++] = 0x0d;
+      out[olen++] = 0x0a;
+      encoder.col = 0;
+    }
 
-    if (strlen(msg->text.transfer_encoding) > 0)
+    if (c == 10 || c == 13)
     {
-      if (strcmp(msg->text.transfer_encoding, Content_Transfer_Encoding::enc_base64) == 0)
-        content += encodeBase64Str((const unsigned char *)s.c_str(), s.length());
-      else if (strcmp(msg->text.transfer_encoding, Content_Transfer_Encoding::enc_qp) == 0)
-      {
-        char *out = (char *)newP(s.length() * 3 + 1);
-        encodeQP(s.c_str(), out);
-        content += out;
-        delP(&out);
-      }
-      else
-        content += s;
+      out[olen++] = c;
+      encoder.col = 0;
+    }
+    else if (c < 32 || c == 61 || c > 126 || (c == 32 && i + 1 < len && (src[i + 1] == 10 || src[i + 1] == 13)))
+    {
+      //the white space at the end of line is also escaped
+      out[olen++] = '=';
+      out[olen++] = (c >> 4) < 10 ? '0' + (c >> 4) : 'A' + (c >> 4) - 10;
+      out[olen++] = (c & 0x0f) < 10 ? '0' + (c & 0x0f) : 'A' + (c & 0x0f) - 10;
+      encoder.col += 3;
     }
     else
-      content += s;
+    {
+      out[olen++] = c;
+      encoder.col++;
+    }
+
+    i++;
   }
-  else if (type == esp_mail_message_type::esp_mail_msg_type_html)
+
+  return i;
+}
+
+bool ESP_Mail_Client::sendQP(SMTPSession *smtp, SMTP_Message *msg, MBSTRING &content, const char *src, size_t len)
+{
+  //send the pending content before the encoded text
+  if (content.length() > 0)
   {
-    char *tmp = nullptr;
-    MBSTRING s = msg->html.content;
-    MBSTRING fnd, rep;
-    SMTP_Attachment *att = nullptr;
-    for (uint8_t i = 0; i < msg->_att.size(); i++)
-    {
-      att = &msg->_att[i];
-      if (att->_int.att_type == esp_mail_att_type_inline)
-      {
-        MBSTRING filename(att->descr.filename);
+    if (!bdat(smtp, msg, content.length(), false))
+      return false;
 
-        size_t found = filename.find_last_of("/\\");
-        if (found != MBSTRING::npos)
-          filename = filename.substr(found + 1);
+    if (smtpSend(smtp, content.c_str()) == ESP_MAIL_CLIENT_TRANSFER_DATA_FAILED)
+      return false;
 
-        appendP(fnd, esp_mail_str_136, true);
-        fnd += filename;
-        appendP(fnd, esp_mail_str_136, false);
+    content.clear();
+  }
 
-        appendP(rep, esp_mail_str_136, true);
-        appendP(rep, esp_mail_str_302, false);
-        if (strlen(att->descr.content_id) > 0)
-          rep += att->descr.content_id;
-        else
-          rep += att->_int.cid;
-        appendP(rep, esp_mail_str_136, false);
+  bool ret = true;
+  size_t chunkSize = (BASE64_CHUNKED_LEN * UPLOAD_CHUNKS_NUM) + (2 * UPLOAD_CHUNKS_NUM);
+  char *buf = (char *)newP(chunkSize);
+  struct esp_mail_qp_encoder_t encoder;
+  size_t ofs = 0;
 
-        tmp = strReplace((char *)s.c_str(), (char *)fnd.c_str(), (char *)rep.c_str());
-        s = tmp;
-        delP(&tmp);
-      }
+  while (ofs < len)
+  {
+    size_t olen = 0;
+    ofs += encodeQP(encoder, src + ofs, len - ofs, buf, chunkSize, olen);
+
+    if (!bdat(smtp, msg, olen, false))
+    {
+      ret = false;
+      break;
     }
 
-    if (strlen(msg->html.transfer_encoding) > 0)
+    if (smtpSend(smtp, (uint8_t *)buf, olen) == ESP_MAIL_CLIENT_TRANSFER_DATA_FAILED)
     {
-      if (strcmp(msg->html.transfer_encoding, Content_Transfer_Encoding::enc_base64) == 0)
-        content += encodeBase64Str((const unsigned char *)s.c_str(), s.length());
-      else if (strcmp(msg->html.transfer_encoding, Content_Transfer_Encoding::enc_qp) == 0)
-      {
-        char *out = (char *)newP(strlen(msg->html.content) * 3 + 1);
-        encodeQP(msg->html.content, out);
-        content += out;
-        delP(&out);
-      }
-      else
-        content += s;
+      ret = false;
+      break;
     }
-    else
-      content += s;
-    MBSTRING().swap(s);
   }
+
+  delP(&buf);
+  return ret;
 }
 
-void ESP_Mail_Client::encodeQP(const char *buf, char *out)
+/**
+ * Replace the quoted inline file names in html with their content ids.
+ * All file names are looked up at each quote while html is copied once.
+*/
+void ESP_Mail_Client::replaceInlineCID(SMTP_Message *msg, const char *html, MBSTRING &out)
 {
-  int n = 0, p = 0, pos = 0;
-  for (n = 0; *buf; buf++)
+  std::vector<struct esp_mail_inline_cid_t> cids;
+
+  for (size_t i = 0; i < msg->_att.size(); i++)
+  {
+    SMTP_Attachment *att = &msg->_att[i];
+    if (att->_int.att_type != esp_mail_att_type_inline)
+      continue;
+
+    struct esp_mail_inline_cid_t item;
+    item.name = att->descr.filename;
+
+    const char *sep = strrchr(item.name, '/');
+    const char *bsep = strrchr(item.name, '\\');
+    if (!sep || (bsep && bsep > sep))
+      sep = bsep;
+    if (sep)
+      item.name = sep + 1;
+
+    item.len = strlen(item.name);
+    item.cid = strlen(att->descr.content_id) > 0 ? att->descr.content_id : att->_int.cid.c_str();
+    cids.push_back(item);
+  }
+
+  if (cids.size() == 0)
+  {
+    out = html;
+    return;
+  }
+
+  esp_mail_flash_str_t qt(esp_mail_str_136);
+  esp_mail_flash_str_t cidP(esp_mail_str_302);
+
+  const char *p = html;
+  const char *end = html + strlen(html);
+
+  while (p < end)
   {
-    if (n >= 73 && *buf != 10 && *buf != 13)
+    const char *open = (const char *)memchr(p, qt.str[0], end - p);
+    if (!open)
     {
-      p = sprintf(out + pos, "=\r\n");
-      pos += p;
-      n = 0;
+      out.append(p, end - p);
+      break;
     }
 
-    if (*buf == 10 || *buf == 13)
+    //the text between this quote and the next one is the candidate file name
+    const char *close = (const char *)memchr(open + 1, qt.str[0], end - open - 1);
+    if (!close)
     {
-      strcat_c(out, *buf);
-      pos++;
-      n = 0;
+      out.append(p, end - p);
+      break;
     }
-    else if (*buf < 32 || *buf == 61 || *buf > 126)
+
+    size_t len = close - open - 1;
+    const char *cid = nullptr;
+    for (size_t i = 0; i < cids.size(); i++)
     {
-      p = sprintf(out + pos, "=%02X", (unsigned char)*buf);
-      n += p;
-      pos += p;
+      if (cids[i].len == len && memcmp(cids[i].name, open + 1, len) == 0)
+      {
+        cid = cids[i].cid;
+        break;
+      }
     }
-    else if (*buf != 32 || (*(buf + 1) != 10 && *(buf + 1) != 13))
+
+    if (cid)
     {
-      strcat_c(out, *buf);
-      n++;
-      pos++;
+      out.append(p, open - p);
+      out += qt.str;
+      out += cidP.str;
+      out += cid;
+      out += qt.str;
+      p = close + 1;
     }
     else
     {
-      p = sprintf(out + pos, "=20");
-      n += p;
-      pos += p;
+      //the closing quote can open the next file name
+      out.append(p, close - p);
+      p = close;
     }
   }
 }
@@ -8179,79 +8668,73 @@ void ESP_Mail_Client::encodeQP(const char *buf, char *out)
  * Some mail clients trim the space before the line break
  * which makes the soft line break cannot be seen.
 */
-void ESP_Mail_Client::formatFlowedText(MBSTRING &content)
+void ESP_Mail_Client::formatFlowedText(const char *content, MBSTRING &out)
 {
-  int count = 0;
-  MBSTRING qms;
-  int j = 0;
-  std::vector<MBSTRING> tokens = std::vector<MBSTRING>();
-  char *stk = strP(esp_mail_str_34);
-  char *qm = strP(esp_mail_str_15);
-  splitTk(content, tokens, stk);
-  content.clear();
-  for (size_t i = 0; i < tokens.size(); i++)
-  {
-    if (tokens[i].length() > 0)
-    {
-      j = 0;
-      qms.clear();
-      while (tokens[i][j] == qm[0])
-      {
-        qms += qm;
-        j++;
-      }
-      softBreak(tokens[i], qms.c_str());
-      if (count > 0)
-        content += stk;
-      content += tokens[i];
-    }
-    else if (count > 0)
-      content += stk;
-    count++;
-  }
+  esp_mail_flash_str_t stk(esp_mail_str_34);
+  esp_mail_flash_str_t sp(esp_mail_str_131);
+  esp_mail_flash_str_t qm(esp_mail_str_15);
 
-  delP(&stk);
-  delP(&qm);
-  tokens.clear();
-}
+  const char *line = content;
 
-void ESP_Mail_Client::softBreak(MBSTRING &content, const char *quoteMarks)
-{
-  size_t len = 0;
-  char *stk = strP(esp_mail_str_131);
-  std::vector<MBSTRING> tokens = std::vector<MBSTRING>();
-  splitTk(content, tokens, stk);
-  content.clear();
-  for (size_t i = 0; i < tokens.size(); i++)
+  while (line)
   {
-    if (tokens[i].length() > 0)
+    const char *eol = strstr(line, stk.str);
+    const char *end = eol ? eol : line + strlen(line);
+
+    //the quote marks are repeated after each soft line break
+    size_t quoteLen = 0;
+    while (line + quoteLen < end && line[quoteLen] == qm.str[0])
+      quoteLen++;
+
+    size_t len = 0;
+    bool lineStart = true;
+    const char *word = line;
+
+    while (word < end)
     {
-      if (len + tokens[i].length() + 3 > FLOWED_TEXT_LEN)
+      //the words are separated by a single space
+      while (word < end && *word == sp.str[0])
+        word++;
+
+      const char *wordEnd = word;
+      while (wordEnd < end && *wordEnd != sp.str[0])
+        wordEnd++;
+
+      size_t wordLen = wordEnd - word;
+      if (wordLen == 0)
+        break;
+
+      if (!lineStart && len + wordLen + 3 > FLOWED_TEXT_LEN)
       {
         /* insert soft crlf */
-        content += stk;
-        appendP(content, esp_mail_str_34, false);
+        out += sp.str;
+        out += stk.str;
 
         /* insert quote marks */
-        if (strlen(quoteMarks) > 0)
-          content += quoteMarks;
-        content += tokens[i];
-        len = tokens[i].length();
+        out.append(line, quoteLen);
+        len = quoteLen;
       }
-      else
+      else if (!lineStart)
       {
-        if (len > 0)
-        {
-          content += stk;
-          len += strlen(stk);
-        }
-        content += tokens[i];
-        len += tokens[i].length();
+        out += sp.str;
+        len++;
       }
+
+      out.append(word, wordLen);
+      len += wordLen;
+      lineStart = false;
+      word = wordEnd;
+    }
+
+    if (eol)
+    {
+      out += stk.str;
+      line = eol + stk.len;
     }
+    else
+      line = nullptr;
   }
-  delP(&stk);
-  tokens.clear();
+
 }
 
 bool ESP_Mail_Client::sendMSG(SMTPSession *smtp, SMTP_Message *msg, const MBSTRING &boundary)
@@ -8363,9 +8846,7 @@ void ESP_Mail_Client::getInlineHeader(MBSTRING &header, const MBSTRING &boundary
   appendP(header, esp_mail_str_299, false);
   header += filename;
   appendP(header, esp_mail_str_327, false);
-  char *tmp = intStr(size);
-  header += tmp;
-  delP(&tmp);
+  appendInt(header, size);
   appendP(header, esp_mail_str_34, false);
 
   appendP(header, esp_mail_str_300, false);
@@ -8430,9 +8911,7 @@ void ESP_Mail_Client::getAttachHeader(MBSTRING &header, const MBSTRING &boundary
     appendP(header, esp_mail_str_30, false);
     header += filename;
     appendP(header, esp_mail_str_327, false);
-    char *tmp = intStr(size);
-    header += tmp;
-    delP(&tmp);
+    appendInt(header, size);
     appendP(header, esp_mail_str_34, false);
   }
 
@@ -8486,55 +8965,33 @@ bool ESP_Mail_Client::sendBase64Raw(SMTPSession *smtp, SMTP_Message *msg, const
 {
   bool ret = false;
 
-  size_t chunkSize = (BASE64_CHUNKED_LEN * UPLOAD_CHUNKS_NUM) + (2 * UPLOAD_CHUNKS_NUM);
-  size_t bufIndex = 0;
+  //the data is already encoded, it is sent as it is in blocks like sendBase64StreamRaw
+  size_t blockSize = len < ESP_MAIL_FILE_READ_BLOCK_SIZE ? len : ESP_MAIL_FILE_READ_BLOCK_SIZE;
   size_t dataIndex = 0;
 
-  if (len < chunkSize)
-    chunkSize = len;
-
-  uint8_t *buf = (uint8_t *)newP(chunkSize);
-  memset(buf, 0, chunkSize);
+  uint8_t *buf = (uint8_t *)newP(blockSize);
 
   int pg = 0, _pg = 0;
 
   if (report)
     uploadReport(filename, dataIndex);
 
-  while (dataIndex < len - 1)
+  while (dataIndex < len)
   {
-
-    size_t size = 4;
-    if (dataIndex + size > len - 1)
-      size = len - dataIndex;
+    size_t size = len - dataIndex < blockSize ? len - dataIndex : blockSize;
 
     if (flashMem)
-      memcpy_P(buf + bufIndex, data + dataIndex, size);
+      memcpy_P(buf, data + dataIndex, size);
     else
-      memcpy(buf + bufIndex, data + dataIndex, size);
+      memcpy(buf, data + dataIndex, size);
 
     dataIndex += size;
-    bufIndex += size;
-
-    if (bufIndex + 1 == BASE64_CHUNKED_LEN)
-    {
-      if (bufIndex + 2 < chunkSize)
-      {
-        buf[bufIndex++] = 0x0d;
-        buf[bufIndex++] = 0x0a;
-      }
-    }
-
-    if (bufIndex + 1 >= chunkSize - size)
-    {
-      if (!bdat(smtp, msg, bufIndex + 1, false))
-        goto ex;
 
-      if (smtpSend(smtp, buf, bufIndex + 1) == ESP_MAIL_CLIENT_TRANSFER_DATA_FAILED)
-        goto ex;
+    if (!bdat(smtp, msg, size, false))
+      goto ex;
 
-      bufIndex = 0;
-    }
+    if (smtpSend(smtp, buf, size) == ESP_MAIL_CLIENT_TRANSFER_DATA_FAILED)
+      goto ex;
 
     if (report)
     {
@@ -8566,119 +9023,59 @@ bool ESP_Mail_Client::sendBase64Stream(SMTPSession *smtp, SMTP_Message *msg, Fil
     return false;
   }
 
-  size_t chunkSize = (BASE64_CHUNKED_LEN * UPLOAD_CHUNKS_NUM) + (2 * UPLOAD_CHUNKS_NUM);
-  size_t byteAdded = 0;
-  size_t byteSent = 0;
+  //the file is read in blocks, the bytes after the last whole triplet are kept for the next block
+  size_t blockSize = ESP_MAIL_FILE_READ_BLOCK_SIZE;
+  size_t chunkSize = 4 * ((blockSize + 4) / 3) + 2 * ((blockSize + 2) / ((BASE64_CHUNKED_LEN / 4) * 3) + 2);
 
+  unsigned char *fbuf = (unsigned char *)newP(blockSize + 2);
   unsigned char *buf = (unsigned char *)newP(chunkSize);
-  memset(buf, 0, chunkSize);
 
   size_t len = file.size();
   size_t fbufIndex = 0;
-  unsigned char *fbuf = (unsigned char *)newP(3);
+  size_t rem = 0;
 
-  int dByte = 0;
-
-  int bcnt = 0;
+  int col = 0;
   int pg = 0, _pg = 0;
 
   if (report)
-    uploadReport(filename, bcnt);
+    uploadReport(filename, pg);
 
-  while (file.available())
+  while (fbufIndex < len)
   {
-    memset(fbuf, 0, 3);
-    if (len - fbufIndex >= 3)
+    size_t size = len - fbufIndex < blockSize ? len - fbufIndex : blockSize;
+    size_t readLen = file.read(fbuf + rem, size);
+    if (readLen != size)
     {
-      bcnt += 3;
-      size_t readLen = file.read(fbuf, 3);
-      if (readLen != 3)
-      {
-        errorStatusCB(smtp, MAIL_CLIENT_ERROR_FILE_IO_ERROR);
-        break;
-      }
-
-      buf[byteAdded++] = b64_index_table[fbuf[0] >> 2];
-      buf[byteAdded++] = b64_index_table[((fbuf[0] & 0x03) << 4) | (fbuf[1] >> 4)];
-      buf[byteAdded++] = b64_index_table[((fbuf[1] & 0x0f) << 2) | (fbuf[2] >> 6)];
-      buf[byteAdded++] = b64_index_table[fbuf[2] & 0x3f];
-      dByte += 4;
-      if (dByte == BASE64_CHUNKED_LEN)
-      {
-        if (byteAdded + 1 < chunkSize)
-        {
-          buf[byteAdded++] = 0x0d;
-          buf[byteAdded++] = 0x0a;
-        }
-        dByte = 0;
-      }
-      if (byteAdded >= chunkSize - 4)
-      {
-        byteSent += byteAdded;
-
-        if (!bdat(smtp, msg, byteAdded, false))
-          goto ex;
+      errorStatusCB(smtp, MAIL_CLIENT_ERROR_FILE_IO_ERROR);
+      goto ex;
+    }
 
-        if (smtpSend(smtp, buf, byteAdded) == ESP_MAIL_CLIENT_TRANSFER_DATA_FAILED)
-          goto ex;
+    fbufIndex += size;
+    size += rem;
 
-        memset(buf, 0, chunkSize);
-        byteAdded = 0;
-      }
-      fbufIndex += 3;
+    bool last = fbufIndex == len;
+    size_t encLen = last ? size : size - size % 3;
+    size_t byteAdded = encodeBase64Lines(fbuf, encLen, buf, col, last);
 
-      if (report)
-      {
-        pg = (float)(100.0f * bcnt / len);
-        if (pg != _pg)
-          uploadReport(filename, pg);
-        _pg = pg;
-      }
-    }
-    else
-    {
-      size_t readLen = file.read(fbuf, len - fbufIndex);
-      if (readLen != len - fbufIndex)
-      {
-        errorStatusCB(smtp, MAIL_CLIENT_ERROR_FILE_IO_ERROR);
-        break;
-      }
-    }
-  }
+    rem = size - encLen;
+    if (rem > 0)
+      memmove(fbuf, fbuf + encLen, rem);
 
-  file.close();
-  if (byteAdded > 0)
-  {
     if (!bdat(smtp, msg, byteAdded, false))
       goto ex;
 
     if (smtpSend(smtp, buf, byteAdded) == ESP_MAIL_CLIENT_TRANSFER_DATA_FAILED)
       goto ex;
-  }
 
-  if (len - fbufIndex > 0)
-  {
-    memset(buf, 0, chunkSize);
-    byteAdded = 0;
-    buf[byteAdded++] = b64_index_table[fbuf[0] >> 2];
-    if (len - fbufIndex == 1)
-    {
-      buf[byteAdded++] = b64_index_table[(fbuf[0] & 0x03) << 4];
-      buf[byteAdded++] = '=';
-    }
-    else
+    if (report)
     {
-      buf[byteAdded++] = b64_index_table[((fbuf[0] & 0x03) << 4) | (fbuf[1] >> 4)];
-      buf[byteAdded++] = b64_index_table[(fbuf[1] & 0x0f) << 2];
+      pg = (float)(100.0f * fbufIndex / len);
+      if (pg != _pg)
+        uploadReport(filename, pg);
+      _pg = pg;
     }
-    buf[byteAdded++] = '=';
-
-    if (!bdat(smtp, msg, byteAdded, false))
-      goto ex;
-
-    if (smtpSend(smtp, buf, byteAdded) == ESP_MAIL_CLIENT_TRANSFER_DATA_FAILED)
-      goto ex;
   }
+
   ret = true;
 
   if (report && _pg < 100)
@@ -8701,76 +9098,45 @@ bool ESP_Mail_Client::sendBase64StreamRaw(SMTPSession *smtp, SMTP_Message *msg,
     return false;
   }
 
-  size_t chunkSize = (BASE64_CHUNKED_LEN * UPLOAD_CHUNKS_NUM) + (2 * UPLOAD_CHUNKS_NUM);
-  size_t bufIndex = 0;
+  size_t blockSize = ESP_MAIL_FILE_READ_BLOCK_SIZE;
   size_t dataIndex = 0;
 
   size_t len = file.size();
 
-  if (len < chunkSize)
-    chunkSize = len;
-
-  uint8_t *buf = (uint8_t *)newP(chunkSize);
-  memset(buf, 0, chunkSize);
+  uint8_t *buf = (uint8_t *)newP(blockSize);
 
   int pg = 0, _pg = 0;
 
-  uint8_t *fbuf = (uint8_t *)newP(4);
-
   if (report)
-    uploadReport(filename, bufIndex);
+    uploadReport(filename, pg);
 
-  while (file.available())
+  while (dataIndex < len)
   {
-
-    if (dataIndex < len - 1)
+    size_t size = len - dataIndex < blockSize ? len - dataIndex : blockSize;
+    size_t readLen = file.read(buf, size);
+    if (readLen != size)
     {
-      size_t size = 4;
-      if (dataIndex + size > len - 1)
-        size = len - dataIndex;
-
-      size_t readLen = file.read(fbuf, size);
-      if (readLen != size)
-      {
-        errorStatusCB(smtp, MAIL_CLIENT_ERROR_FILE_IO_ERROR);
-        break;
-      }
-
-      memcpy(buf + bufIndex, fbuf, size);
-
-      bufIndex += size;
-
-      if (bufIndex + 1 == BASE64_CHUNKED_LEN)
-      {
-        if (bufIndex + 2 < chunkSize)
-        {
-          buf[bufIndex++] = 0x0d;
-          buf[bufIndex++] = 0x0a;
-        }
-      }
+      errorStatusCB(smtp, MAIL_CLIENT_ERROR_FILE_IO_ERROR);
+      goto ex;
+    }
 
-      if (bufIndex + 1 >= chunkSize - size)
-      {
-        if (!bdat(smtp, msg, bufIndex + 1, false))
-          goto ex;
+    dataIndex += size;
 
-        if (smtpSend(smtp, buf, bufIndex + 1) == ESP_MAIL_CLIENT_TRANSFER_DATA_FAILED)
-          goto ex;
+    if (!bdat(smtp, msg, size, false))
+      goto ex;
 
-        bufIndex = 0;
-      }
+    if (smtpSend(smtp, buf, size) == ESP_MAIL_CLIENT_TRANSFER_DATA_FAILED)
+      goto ex;
 
-      if (report)
-      {
-        pg = (float)(100.0f * dataIndex / len);
-        if (pg != _pg)
-          uploadReport(filename, pg);
-        _pg = pg;
-      }
+    if (report)
+    {
+      pg = (float)(100.0f * dataIndex / len);
+      if (pg != _pg)
+        uploadReport(filename, pg);
+      _pg = pg;
     }
   }
 
-  file.close();
   ret = true;
 
   if (report && _pg < 100)
@@ -8778,7 +9144,6 @@ bool ESP_Mail_Client::sendBase64StreamRaw(SMTPSession *smtp, SMTP_Message *msg,
 
 ex:
   delP(&buf);
-  delP(&fbuf);
   file.close();
   return ret;
 }
@@ -8816,10 +9181,7 @@ void ESP_Mail_Client::handleAuth(SMTPSession *smtp, char *buf)
 
 int ESP_Mail_Client::available(SMTPSession *smtp)
 {
-  int sz = 0;
-  if (smtp->tcpClient.stream())
-    sz = smtp->tcpClient.stream()->available();
-  return sz;
+  return readerAvailable(smtp->tcpClient.stream(), smtp->_reader);
 }
 
 bool ESP_Mail_Client::handleSMTPResponse(SMTPSession *smtp, esp_mail_smtp_status_code respCode, int errCode)
@@ -8884,7 +9246,7 @@ bool ESP_Mail_Client::handleSMTPResponse(SMTPSession *smtp, esp_mail_smtp_status
         chunkBufSize = 512;
         response = (char *)newP(chunkBufSize + 1);
 
-        readLen = readLine(smtp->tcpClient.stream(), response, chunkBufSize, false, count);
+        readLen = readLine(smtp->tcpClient.stream(), smtp->_reader, response, chunkBufSize, false, count);
 
         if (readLen)
         {
@@ -8989,10 +9351,8 @@ void ESP_Mail_Client::getResponseStatus(const char *buf, esp_mail_smtp_status_co
   int p1 = 0;
   if (respCode > esp_mail_smtp_status_code_0)
   {
-    tmp = intStr((int)respCode);
-    s = tmp;
+    appendInt(s, (int)respCode);
     appendP(s, esp_mail_str_131, false);
-    delP(&tmp);
     p1 = strpos(buf, (const char *)s.c_str(), beginPos);
   }
 
@@ -9038,6 +9398,7 @@ void ESP_Mail_Client::closeTCPSession(SMTPSession *smtp)
     _lastReconnectMillis = millis();
   }
   smtp->_tcpConnected = false;
+  clearReader(smtp->_reader);
 }
 
 bool ESP_Mail_Client::reconnect(SMTPSession *smtp, unsigned long dataTime)
@@ -9083,12 +9444,10 @@ void ESP_Mail_Client::uploadReport(const char *filename, int progress)
   if (progress % ESP_MAIL_PROGRESS_REPORT_STEP == 0)
   {
     MBSTRING s;
-    char *tmp = intStr(progress);
     appendP(s, esp_mail_str_160, true);
     s += filename;
     appendP(s, esp_mail_str_91, false);
-    s += tmp;
-    delP(&tmp);
+    appendInt(s, progress);
     appendP(s, esp_mail_str_92, false);
     appendP(s, esp_mail_str_34, false);
     esp_mail_debug_line(s.c_str(), false);
@@ -9121,121 +9480,53 @@ MBSTRING ESP_Mail_Client::getBoundary(size_t len)
 bool ESP_Mail_Client::sendBase64(SMTPSession *smtp, SMTP_Message *msg, const unsigned char *data, size_t len, bool flashMem, const char *filename, bool report)
 {
   bool ret = false;
-  const unsigned char *end, *in;
-
-  end = data + len;
-  in = data;
 
+  //the input block is encoded to whole lines which fill the output buffer
   size_t chunkSize = (BASE64_CHUNKED_LEN * UPLOAD_CHUNKS_NUM) + (2 * UPLOAD_CHUNKS_NUM);
-  size_t byteAdded = 0;
-  size_t byteSent = 0;
+  size_t blockSize = (BASE64_CHUNKED_LEN / 4) * 3 * UPLOAD_CHUNKS_NUM;
+  size_t dataIndex = 0;
 
-  int dByte = 0;
   unsigned char *buf = (unsigned char *)newP(chunkSize);
-  memset(buf, 0, chunkSize);
 
-  unsigned char *tmp = (unsigned char *)newP(3);
-  int bcnt = 0;
+  //the flash data is copied to RAM before encoding
+  unsigned char *tmp = nullptr;
+  if (flashMem)
+    tmp = (unsigned char *)newP(blockSize);
+
+  int col = 0;
   int pg = 0, _pg = 0;
 
   if (report)
-    uploadReport(filename, bcnt);
+    uploadReport(filename, pg);
 
-  while (end - in >= 3)
+  while (dataIndex < len)
   {
+    size_t size = len - dataIndex < blockSize ? len - dataIndex : blockSize;
+    const unsigned char *in = data + dataIndex;
 
-    memset(tmp, 0, 3);
     if (flashMem)
-      memcpy_P(tmp, in, 3);
-    else
-      memcpy(tmp, in, 3);
-    bcnt += 3;
-
-    buf[byteAdded++] = b64_index_table[tmp[0] >> 2];
-    buf[byteAdded++] = b64_index_table[((tmp[0] & 0x03) << 4) | (tmp[1] >> 4)];
-    buf[byteAdded++] = b64_index_table[((tmp[1] & 0x0f) << 2) | (tmp[2] >> 6)];
-    buf[byteAdded++] = b64_index_table[tmp[2] & 0x3f];
-    dByte += 4;
-    if (dByte == BASE64_CHUNKED_LEN)
     {
-      if (byteAdded + 1 < chunkSize)
-      {
-        buf[byteAdded++] = 0x0d;
-        buf[byteAdded++] = 0x0a;
-      }
-      dByte = 0;
+      memcpy_P(tmp, in, size);
+      in = tmp;
     }
-    if (byteAdded >= chunkSize - 4)
-    {
-      byteSent += byteAdded;
-
-      if (!bdat(smtp, msg, byteAdded, false))
-        goto ex;
 
-      if (smtpSend(smtp, buf, byteAdded) == ESP_MAIL_CLIENT_TRANSFER_DATA_FAILED)
-        goto ex;
-      memset(buf, 0, chunkSize);
-      byteAdded = 0;
-    }
-    in += 3;
+    dataIndex += size;
 
-    if (report)
-    {
-      pg = (float)(100.0f * bcnt / len);
-      if (pg != _pg)
-        uploadReport(filename, pg);
-      _pg = pg;
-    }
-  }
+    size_t byteAdded = encodeBase64Lines(in, size, buf, col, dataIndex == len);
 
-  if (byteAdded > 0)
-  {
     if (!bdat(smtp, msg, byteAdded, false))
       goto ex;
 
     if (smtpSend(smtp, buf, byteAdded) == ESP_MAIL_CLIENT_TRANSFER_DATA_FAILED)
       goto ex;
-  }
-
-  if (end - in)
-  {
-    memset(buf, 0, chunkSize);
-    byteAdded = 0;
-    memset(tmp, 0, 3);
-    if (flashMem)
-    {
-      if (end - in == 1)
-        memcpy_P(tmp, in, 1);
-      else
-        memcpy_P(tmp, in, 2);
-    }
-    else
-    {
-      if (end - in == 1)
-        memcpy(tmp, in, 1);
-      else
-        memcpy(tmp, in, 2);
-    }
 
-    buf[byteAdded++] = b64_index_table[tmp[0] >> 2];
-    if (end - in == 1)
-    {
-      buf[byteAdded++] = b64_index_table[(tmp[0] & 0x03) << 4];
-      buf[byteAdded++] = '=';
-    }
-    else
+    if (report)
     {
-      buf[byteAdded++] = b64_index_table[((tmp[0] & 0x03) << 4) | (tmp[1] >> 4)];
-      buf[byteAdded++] = b64_index_table[(tmp[1] & 0x0f) << 2];
+      pg = (float)(100.0f * dataIndex / len);
+      if (pg != _pg)
+        uploadReport(filename, pg);
+      _pg = pg;
     }
-    buf[byteAdded++] = '=';
-
-    if (!bdat(smtp, msg, byteAdded, false))
-      goto ex;
-
-    if (smtpSend(smtp, buf, byteAdded) == ESP_MAIL_CLIENT_TRANSFER_DATA_FAILED)
-      goto ex;
-    memset(buf, 0, chunkSize);
   }
 
   if (report && _pg < 100)
@@ -9257,6 +9548,7 @@ SMTPSession::SMTPSession()
 SMTPSession::~SMTPSession()
 {
   closeSession();
+  MailClient.clearReader(_reader);
 #if defined(ESP32) || defined(ESP8266)
   _caCert.reset();
   _caCert = nullptr;
@@ -9289,7 +9581,11 @@ bool SMTPSession::connect(ESP_Mail_Session *config)
     }
 #endif
   }
-  return MailClient.smtpAuth(this);
+  MailClient.beginAllocStats();
+  bool ret = MailClient.smtpAuth(this);
+  MailClient.smtpPhase(this, esp_mail_smtp_phase_max);
+  MailClient.endAllocStats(_debug);
+  return ret;
 }
 
 void SMTPSession::debug(int level)
@@ -9382,9 +9678,7 @@ String SMTPSession::errorReason()
   if (_smtpStatus.text.length() > 0 && ret.length() == 0)
   {
     MailClient.appendP(ret, esp_mail_str_312, true);
-    char *code = MailClient.intStr(_smtpStatus.respCode);
-    ret += code;
-    MailClient.delP(&code);
+    MailClient.appendInt(ret, _smtpStatus.respCode);
     MailClient.appendP(ret, esp_mail_str_313, false);
     ret += _smtpStatus.text;
     return ret.c_str();
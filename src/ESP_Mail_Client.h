@@ -45,7 +45,7 @@
 */
 
 #include <Arduino.h>
-#include "extras/RFC2047.h"
+#include "ESP_Mail_FS.h"
 #include "extras/ESPTimeHelper/ESPTimeHelper.h"
 #include <time.h>
 #include <ctype.h>
@@ -168,7 +168,32 @@ extern char *__brkval;
 #define ESP_MAIL_PROGRESS_REPORT_STEP 20
 #define ESP_MAIL_CLIENT_TRANSFER_DATA_FAILED 0
 #define ESP_MAIL_CLIENT_STREAM_CHUNK_SIZE 256
+#define ESP_MAIL_CLIENT_READ_BUFFER_SIZE 1024
 #define ESP_MAIL_CLIENT_VALID_TS 1577836800
+#define ESP_MAIL_ALLOC_HEADER_SIZE 8
+#define ESP_MAIL_IMAP_LATENCY_BUCKETS 8
+
+#if !defined(ESP_MAIL_FILE_READ_BLOCK_SIZE)
+#if defined(ESP32)
+#define ESP_MAIL_FILE_READ_BLOCK_SIZE 4096
+#elif defined(ESP8266)
+#define ESP_MAIL_FILE_READ_BLOCK_SIZE 1024
+#else
+#define ESP_MAIL_FILE_READ_BLOCK_SIZE 512
+#endif
+#endif
+
+#if defined(ESP8266)
+#define ESP_MAIL_FLASH_STR_BUF_SIZE 48
+#endif
+
+#if !defined(ESP_MAIL_ARENA_SIZE)
+#if defined(ESP8266)
+#define ESP_MAIL_ARENA_SIZE 1024
+#else
+#define ESP_MAIL_ARENA_SIZE 2048
+#endif
+#endif
 
 class IMAPSession;
 class SMTPSession;
@@ -212,6 +237,169 @@ enum esp_mail_debug_level
   esp_mail_debug_level_3 = 333
 };
 
+enum esp_mail_alloc_type
+{
+  esp_mail_alloc_type_buffer,
+  esp_mail_alloc_type_flash_string,
+  esp_mail_alloc_type_integer,
+  esp_mail_alloc_type_substring,
+  esp_mail_alloc_type_max
+};
+
+#if defined(ENABLE_ALLOC_STATS)
+struct esp_mail_alloc_stats_t
+{
+  /* The number of internal buffers allocated */
+  size_t count = 0;
+
+  /* The number of internal buffers freed */
+  size_t freeCount = 0;
+
+  /* The total bytes allocated */
+  size_t bytes = 0;
+
+  /* The bytes currently allocated */
+  size_t liveBytes = 0;
+
+  /* The highest bytes allocated at the same time */
+  size_t peakBytes = 0;
+
+  /* The number of allocations of each esp_mail_alloc_type */
+  size_t typeCount[esp_mail_alloc_type_max] = {0};
+};
+#endif
+
+struct esp_mail_arena_t
+{
+  /* The storage of the short-lived strings, the flash strings, integers and substrings */
+  char buf[ESP_MAIL_ARENA_SIZE];
+
+  /* The bytes in use from the start of buf */
+  size_t used = 0;
+
+  /* The offset of the most recent string which can be given back before the others */
+  size_t last = ESP_MAIL_ARENA_SIZE;
+
+  /* The number of strings not freed yet, the arena is rewound when it drops to zero */
+  size_t live = 0;
+
+#if defined(ESP32)
+  /* The arena is shared by all sessions, which may run in different tasks */
+  portMUX_TYPE mux = portMUX_INITIALIZER_UNLOCKED;
+#endif
+};
+
+struct esp_mail_line_reader_t
+{
+  /* The data read from the server */
+  uint8_t *buf = nullptr;
+
+  /* The number of bytes in buf */
+  size_t len = 0;
+
+  /* The position of the next unread byte */
+  size_t pos = 0;
+};
+
+struct esp_mail_base64_decoder_t
+{
+  /* The sextets of the incomplete quantum */
+  unsigned char quad[4];
+
+  /* The number of sextets in quad */
+  uint8_t count = 0;
+
+  /* The number of padding characters in quad */
+  uint8_t pad = 0;
+
+  /* The padding was found, the rest of the data is ignored */
+  bool done = false;
+};
+
+struct esp_mail_qp_encoder_t
+{
+  /* The length of the current output line */
+  int col = 0;
+};
+
+struct esp_mail_qp_decoder_t
+{
+  /* The '=' and the characters after it which are not decoded yet */
+  char pending[2];
+
+  /* The number of characters in pending */
+  uint8_t count = 0;
+};
+
+struct esp_mail_inline_cid_t
+{
+  /* The inline file name without path */
+  const char *name = nullptr;
+
+  /* The length of name */
+  size_t len = 0;
+
+  /* The content id which replaces the quoted file name */
+  const char *cid = nullptr;
+};
+
+/** The view of the string constant in flash which is used in place.
+ * The ESP8266 flash is not byte addressable, the string is copied to
+ * the stack (or heap for the long string) instead.
+*/
+struct esp_mail_flash_str_t
+{
+  explicit esp_mail_flash_str_t(PGM_P pgm)
+  {
+    len = strlen_P(pgm);
+#if defined(ESP8266)
+    char *p = buf;
+    if (len >= sizeof(buf))
+    {
+      heap = (char *)malloc(len + 1);
+      p = heap;
+    }
+
+    if (p)
+      memcpy_P(p, pgm, len + 1);
+    else
+    {
+      buf[0] = 0;
+      len = 0;
+      p = buf;
+    }
+    str = p;
+#else
+    str = pgm;
+#endif
+  }
+
+  ~esp_mail_flash_str_t()
+  {
+#if defined(ESP8266)
+    if (heap)
+      free(heap);
+#endif
+  }
+
+  esp_mail_flash_str_t(const esp_mail_flash_str_t &) = delete;
+  esp_mail_flash_str_t &operator=(const esp_mail_flash_str_t &) = delete;
+
+  /* The readable string */
+  const char *str = nullptr;
+
+  /* The length of str */
+  size_t len = 0;
+
+#if defined(ESP8266)
+  /* The copy of the short string */
+  char buf[ESP_MAIL_FLASH_STR_BUF_SIZE];
+
+  /* The copy of the long string */
+  char *heap = nullptr;
+#endif
+};
+
 struct esp_mail_internal_use_t
 {
   bool binary = false;
@@ -534,6 +722,42 @@ struct esp_mail_smtp_recipient_address_t
   const char *email = "";
 };
 
+/** The SMTP sending phases
+ * The connection phases (connect, TLS handshake, greeting, EHLO, STARTTLS and
+ * AUTH) belong to the session connection and the remaining phases belong to
+ * the message.
+ * The TLS handshake of the SSL port connection is included in the connect
+ * phase, the TLS handshake phase is the handshake after STARTTLS.
+*/
+enum esp_mail_smtp_phase
+{
+  esp_mail_smtp_phase_connect,
+  esp_mail_smtp_phase_tls_handshake,
+  esp_mail_smtp_phase_greeting,
+  esp_mail_smtp_phase_ehlo,
+  esp_mail_smtp_phase_start_tls,
+  esp_mail_smtp_phase_auth,
+  esp_mail_smtp_phase_mail_from,
+  esp_mail_smtp_phase_rcpt,
+  esp_mail_smtp_phase_data,
+  esp_mail_smtp_phase_attachment,
+  esp_mail_smtp_phase_end,
+  esp_mail_smtp_phase_max
+};
+
+struct esp_mail_smtp_phase_info_t
+{
+  /* The time spent in this phase in ms */
+  uint32_t time = 0;
+
+  /* The bytes sent in this phase */
+  size_t bytes = 0;
+
+  /* The number of times the phase was entered e.g. one per recipient or
+   * attachment */
+  uint16_t count = 0;
+};
+
 struct esp_mail_smtp_send_status_t
 {
   /* The status of the message */
@@ -547,6 +771,9 @@ struct esp_mail_smtp_send_status_t
 
   /* The timestamp of the message */
   uint32_t timestamp = 0;
+
+  /* The time and bytes of each sending phase, indexed by esp_mail_smtp_phase */
+  struct esp_mail_smtp_phase_info_t phases[esp_mail_smtp_phase_max];
 };
 
 struct esp_mail_smtp_capability_t
@@ -614,7 +841,26 @@ enum esp_mail_char_decoding_scheme
 {
   esp_mail_char_decoding_scheme_default,
   esp_mail_char_decoding_scheme_iso8859_1,
-  esp_mail_char_decoding_scheme_tis620
+  esp_mail_char_decoding_scheme_tis620,
+  esp_mail_char_decoding_scheme_iso8859_2,
+  esp_mail_char_decoding_scheme_iso8859_5,
+  esp_mail_char_decoding_scheme_iso8859_15,
+  esp_mail_char_decoding_scheme_windows_1250,
+  esp_mail_char_decoding_scheme_windows_1251,
+  esp_mail_char_decoding_scheme_windows_1252,
+  esp_mail_char_decoding_scheme_koi8_r
+};
+
+struct esp_mail_charset_t
+{
+  /* The charset name */
+  PGM_P name;
+
+  /* The decoding scheme of the charset */
+  esp_mail_char_decoding_scheme scheme;
+
+  /* The Unicode code points of the bytes 0x80 to 0xff, 0 for the bytes to be skipped, nullptr for ISO-8859-1 */
+  const uint16_t *table;
 };
 
 enum esp_mail_imap_port
@@ -668,6 +914,30 @@ enum esp_mail_imap_header_state
   esp_mail_imap_state_boundary
 };
 
+enum esp_mail_header_field
+{
+  esp_mail_header_field_unknown,
+  esp_mail_header_field_from,
+  esp_mail_header_field_sender,
+  esp_mail_header_field_to,
+  esp_mail_header_field_cc,
+  esp_mail_header_field_subject,
+  esp_mail_header_field_return_path,
+  esp_mail_header_field_reply_to,
+  esp_mail_header_field_in_reply_to,
+  esp_mail_header_field_references,
+  esp_mail_header_field_comments,
+  esp_mail_header_field_keywords,
+  esp_mail_header_field_content_type,
+  esp_mail_header_field_content_transfer_encoding,
+  esp_mail_header_field_accept_language,
+  esp_mail_header_field_content_language,
+  esp_mail_header_field_date,
+  esp_mail_header_field_msg_id,
+  esp_mail_header_field_content_description,
+  esp_mail_header_field_content_disposition
+};
+
 enum esp_mail_imap_command
 {
   esp_mail_imap_cmd_capability,
@@ -696,6 +966,7 @@ enum esp_mail_imap_command
   esp_mail_imap_cmd_get_uid,
   esp_mail_imap_cmd_get_flags,
   esp_mail_imap_cmd_custom,
+  esp_mail_imap_cmd_max
 };
 
 enum esp_mail_imap_mime_fetch_type
@@ -743,6 +1014,26 @@ struct esp_mail_imap_response_status_t
   MBSTRING text;
 };
 
+struct esp_mail_imap_command_stats_t
+{
+  /* The number of responses handled for the command */
+  uint32_t count = 0;
+
+  /* The bytes read from the server */
+  uint32_t readBytes = 0;
+
+  /* The bytes written to the server */
+  uint32_t writeBytes = 0;
+
+  /* The total response time in ms */
+  uint32_t totalTime = 0;
+
+  /* The number of responses in each latency bucket, the bucket upper limits are
+   * 50, 100, 250, 500, 1000, 2500 and 5000 ms, the last bucket is 5000 ms or
+   * longer */
+  uint16_t histogram[ESP_MAIL_IMAP_LATENCY_BUCKETS] = {0};
+};
+
 struct esp_mail_imap_capability_t
 {
   bool imap4 = false;
@@ -751,23 +1042,115 @@ struct esp_mail_imap_capability_t
   bool idle = false;
 };
 
+enum esp_mail_rfc822_header_field_types
+{
+  esp_mail_rfc822_header_field_sender,
+  esp_mail_rfc822_header_field_from,
+  esp_mail_rfc822_header_field_subject,
+  esp_mail_rfc822_header_field_messageID,
+  esp_mail_rfc822_header_field_keywords,
+  esp_mail_rfc822_header_field_comments,
+  esp_mail_rfc822_header_field_date,
+  esp_mail_rfc822_header_field_return_path,
+  esp_mail_rfc822_header_field_reply_to,
+  esp_mail_rfc822_header_field_to,
+  esp_mail_rfc822_header_field_cc,
+  esp_mail_rfc822_header_field_bcc,
+  esp_mail_rfc822_header_field_in_reply_to,
+  esp_mail_rfc822_header_field_references,
+  esp_mail_rfc822_header_field_flags,
+  esp_mail_rfc822_header_field_maxType
+};
+
 struct esp_mail_imap_rfc822_msg_header_item_t
 {
-  MBSTRING sender;
-  MBSTRING from;
-  MBSTRING subject;
-  MBSTRING messageID;
-  MBSTRING keywords;
-  MBSTRING comments;
-  MBSTRING date;
-  MBSTRING return_path;
-  MBSTRING reply_to;
-  MBSTRING to;
-  MBSTRING cc;
-  MBSTRING bcc;
-  MBSTRING in_reply_to;
-  MBSTRING references;
-  MBSTRING flags;
+  /** Get the field value, the empty string when the field was not set
+   *
+   * The pointer stays valid until the field values are changed.
+  */
+  const char *get(esp_mail_rfc822_header_field_types field) const
+  {
+    return len[field] > 0 ? &blob[ofs[field]] : "";
+  }
+
+  size_t length(esp_mail_rfc822_header_field_types field) const
+  {
+    return len[field];
+  }
+
+  /** Replace the field value
+   *
+   * A value no longer than the current one is written over it, a longer one
+   * is stored at the end of the blob.
+  */
+  void set(esp_mail_rfc822_header_field_types field, const char *value)
+  {
+    size_t n = strlen(value);
+    if (n > 0 && n <= len[field])
+    {
+      memcpy(&blob[ofs[field]], value, n + 1);
+      len[field] = n;
+      return;
+    }
+
+    len[field] = 0;
+    append(field, value);
+  }
+
+  /** Append to the field value
+   *
+   * The last stored value grows in place, the others are copied to the end
+   * of the blob and their old copy is dropped by compact().
+  */
+  void append(esp_mail_rfc822_header_field_types field, const char *value)
+  {
+    size_t n = strlen(value);
+    size_t l = len[field];
+    bool last = l > 0 && ofs[field] + l + 1 == blob.size();
+    size_t o = last ? ofs[field] : blob.size();
+
+    if (n == 0)
+      return;
+
+    blob.resize(o + l + n + 1);
+    if (!last && l > 0)
+      memcpy(&blob[o], &blob[ofs[field]], l);
+    memcpy(&blob[o + l], value, n);
+    blob[o + l + n] = 0;
+    ofs[field] = o;
+    len[field] = l + n;
+  }
+
+  /* Rebuild the blob in one exact sized buffer without the stale copies */
+  void compact()
+  {
+    size_t size = 0;
+    for (int i = 0; i < esp_mail_rfc822_header_field_maxType; i++)
+    {
+      if (len[i] > 0)
+        size += len[i] + 1;
+    }
+
+    std::vector<char> b;
+    b.reserve(size);
+    for (int i = 0; i < esp_mail_rfc822_header_field_maxType; i++)
+    {
+      if (len[i] > 0)
+      {
+        size_t o = b.size();
+        b.insert(b.end(), blob.begin() + ofs[i], blob.begin() + ofs[i] + len[i] + 1);
+        ofs[i] = o;
+      }
+    }
+    blob.swap(b);
+  }
+
+  /* The NUL terminated field values stored back to back */
+  std::vector<char> blob = std::vector<char>();
+
+  /* The offset and length of each field value in blob */
+  size_t ofs[esp_mail_rfc822_header_field_maxType] = {0};
+  size_t len[esp_mail_rfc822_header_field_maxType] = {0};
 };
 
 /* descrete media types (rfc 2046) */
@@ -980,12 +1363,15 @@ struct esp_mail_message_part_info_t
   MBSTRING save_path;
   MBSTRING name;
   MBSTRING content_disposition;
-  MBSTRING content_type;
+  /* The interned value, see ESP_Mail_Client::internStr */
+  const char *content_type = "";
   MBSTRING descr;
-  MBSTRING content_transfer_encoding;
+  /* The interned value, see ESP_Mail_Client::internStr */
+  const char *content_transfer_encoding = "";
   MBSTRING creation_date;
   MBSTRING modification_date;
-  MBSTRING charset;
+  /* The interned value, see ESP_Mail_Client::internStr */
+  const char *charset = "";
   MBSTRING download_error;
   esp_mail_attach_type attach_type = esp_mail_att_type_none;
   esp_mail_message_type msg_type = esp_mail_msg_type_none;
@@ -1024,7 +1410,8 @@ struct esp_mail_message_header_t
   esp_mail_imap_multipart_sub_type multipart_sub_type = esp_mail_imap_multipart_sub_type_none;
   esp_mail_imap_message_sub_type message_sub_type = esp_mail_imap_message_sub_type_none;
   MBSTRING msgID;
-  MBSTRING flags;
+  /* The interned value, see ESP_Mail_Client::internStr */
+  const char *flags = "";
   MBSTRING error_msg;
   bool error = false;
   std::vector<struct esp_mail_message_part_info_t> part_headers = std::vector<struct esp_mail_message_part_info_t>();
@@ -1413,6 +1800,9 @@ typedef struct esp_mail_attachment_info_t IMAP_Attach_Item;
 /** The IMAP operation configuations */
 typedef struct esp_mail_imap_read_config_t IMAP_Config;
 
+/* The count, bytes and latency histogram of the IMAP command */
+typedef struct esp_mail_imap_command_stats_t IMAP_Command_Stats;
+
 /* The message item data of the IMAP_MSG_List which contains header, body and
  * attachments info for eacch message*/
 typedef struct esp_mail_imap_msg_item_t IMAP_MSG_Item;
@@ -1731,6 +2121,16 @@ static const char esp_mail_str_339[] PROGMEM = "> C: polling established";
 static const char esp_mail_str_340[] PROGMEM = "Mailbox listening stopped";
 static const char esp_mail_str_341[] PROGMEM = "> C: mailbox listening stopped";
 static const char esp_mail_str_342[] PROGMEM = " FETCH (UID ";
+static const char esp_mail_str_351[] PROGMEM = "iso-8859-2";
+static const char esp_mail_str_352[] PROGMEM = "iso-8859-5";
+static const char esp_mail_str_353[] PROGMEM = "iso-8859-15";
+static const char esp_mail_str_354[] PROGMEM = "windows-1250";
+static const char esp_mail_str_355[] PROGMEM = "windows-1251";
+static const char esp_mail_str_356[] PROGMEM = "windows-1252";
+static const char esp_mail_str_357[] PROGMEM = "koi8-r";
+static const char esp_mail_str_358[] PROGMEM = "utf-8";
+static const char esp_mail_str_359[] PROGMEM = "=?";
+static const char esp_mail_str_360[] PROGMEM = "?=";
 
 // Tagged
 static const char esp_mail_imap_response_1[] PROGMEM = "$ OK ";
@@ -1781,6 +2181,99 @@ static const char imap_7bit_val12[] PROGMEM = "&ndash;";
 static const char imap_7bit_key13[] PROGMEM = "=E2=80=94";
 static const char imap_7bit_val13[] PROGMEM = "&mdash;";
 
+static const uint16_t esp_mail_charset_iso8859_2[128] PROGMEM = {
+  0x0080, 0x0081, 0x0082, 0x0083, 0x0084, 0x0085, 0x0086, 0x0087, 0x0088, 0x0089, 0x008a, 0x008b, 0x008c, 0x008d, 0x008e, 0x008f,
+  0x0090, 0x0091, 0x0092, 0x0093, 0x0094, 0x0095, 0x0096, 0x0097, 0x0098, 0x0099, 0x009a, 0x009b, 0x009c, 0x009d, 0x009e, 0x009f,
+  0x00a0, 0x0104, 0x02d8, 0x0141, 0x00a4, 0x013d, 0x015a, 0x00a7, 0x00a8, 0x0160, 0x015e, 0x0164, 0x0179, 0x00ad, 0x017d, 0x017b,
+  0x00b0, 0x0105, 0x02db, 0x0142, 0x00b4, 0x013e, 0x015b, 0x02c7, 0x00b8, 0x0161, 0x015f, 0x0165, 0x017a, 0x02dd, 0x017e, 0x017c,
+  0x0154, 0x00c1, 0x00c2, 0x0102, 0x00c4, 0x0139, 0x0106, 0x00c7, 0x010c, 0x00c9, 0x0118, 0x00cb, 0x011a, 0x00cd, 0x00ce, 0x010e,
+  0x0110, 0x0143, 0x0147, 0x00d3, 0x00d4, 0x0150, 0x00d6, 0x00d7, 0x0158, 0x016e, 0x00da, 0x0170, 0x00dc, 0x00dd, 0x0162, 0x00df,
+  0x0155, 0x00e1, 0x00e2, 0x0103, 0x00e4, 0x013a, 0x0107, 0x00e7, 0x010d, 0x00e9, 0x0119, 0x00eb, 0x011b, 0x00ed, 0x00ee, 0x010f,
+  0x0111, 0x0144, 0x0148, 0x00f3, 0x00f4, 0x0151, 0x00f6, 0x00f7, 0x0159, 0x016f, 0x00fa, 0x0171, 0x00fc, 0x00fd, 0x0163, 0x02d9};
+
+static const uint16_t esp_mail_charset_iso8859_5[128] PROGMEM = {
+  0x0080, 0x0081, 0x0082, 0x0083, 0x0084, 0x0085, 0x0086, 0x0087, 0x0088, 0x0089, 0x008a, 0x008b, 0x008c, 0x008d, 0x008e, 0x008f,
+  0x0090, 0x0091, 0x0092, 0x0093, 0x0094, 0x0095, 0x0096, 0x0097, 0x0098, 0x0099, 0x009a, 0x009b, 0x009c, 0x009d, 0x009e, 0x009f,
+  0x00a0, 0x0401, 0x0402, 0x0403, 0x0404, 0x0405, 0x0406, 0x0407, 0x0408, 0x0409, 0x040a, 0x040b, 0x040c, 0x00ad, 0x040e, 0x040f,
+  0x0410, 0x0411, 0x0412, 0x0413, 0x0414, 0x0415, 0x0416, 0x0417, 0x0418, 0x0419, 0x041a, 0x041b, 0x041c, 0x041d, 0x041e, 0x041f,
+  0x0420, 0x0421, 0x0422, 0x0423, 0x0424, 0x0425, 0x0426, 0x0427, 0x0428, 0x0429, 0x042a, 0x042b, 0x042c, 0x042d, 0x042e, 0x042f,
+  0x0430, 0x0431, 0x0432, 0x0433, 0x0434, 0x0435, 0x0436, 0x0437, 0x0438, 0x0439, 0x043a, 0x043b, 0x043c, 0x043d, 0x043e, 0x043f,
+  0x0440, 0x0441, 0x0442, 0x0443, 0x0444, 0x0445, 0x0446, 0x0447, 0x0448, 0x0449, 0x044a, 0x044b, 0x044c, 0x044d, 0x044e, 0x044f,
+  0x2116, 0x0451, 0x0452, 0x0453, 0x0454, 0x0455, 0x0456, 0x0457, 0x0458, 0x0459, 0x045a, 0x045b, 0x045c, 0x00a7, 0x045e, 0x045f};
+
+static const uint16_t esp_mail_charset_iso8859_15[128] PROGMEM = {
+  0x0080, 0x0081, 0x0082, 0x0083, 0x0084, 0x0085, 0x0086, 0x0087, 0x0088, 0x0089, 0x008a, 0x008b, 0x008c, 0x008d, 0x008e, 0x008f,
+  0x0090, 0x0091, 0x0092, 0x0093, 0x0094, 0x0095, 0x0096, 0x0097, 0x0098, 0x0099, 0x009a, 0x009b, 0x009c, 0x009d, 0x009e, 0x009f,
+  0x00a0, 0x00a1, 0x00a2, 0x00a3, 0x20ac, 0x00a5, 0x0160, 0x00a7, 0x0161, 0x00a9, 0x00aa, 0x00ab, 0x00ac, 0x00ad, 0x00ae, 0x00af,
+  0x00b0, 0x00b1, 0x00b2, 0x00b3, 0x017d, 0x00b5, 0x00b6, 0x00b7, 0x017e, 0x00b9, 0x00ba, 0x00bb, 0x0152, 0x0153, 0x0178, 0x00bf,
+  0x00c0, 0x00c1, 0x00c2, 0x00c3, 0x00c4, 0x00c5, 0x00c6, 0x00c7, 0x00c8, 0x00c9, 0x00ca, 0x00cb, 0x00cc, 0x00cd, 0x00ce, 0x00cf,
+  0x00d0, 0x00d1, 0x00d2, 0x00d3, 0x00d4, 0x00d5, 0x00d6, 0x00d7, 0x00d8, 0x00d9, 0x00da, 0x00db, 0x00dc, 0x00dd, 0x00de, 0x00df,
+  0x00e0, 0x00e1, 0x00e2, 0x00e3, 0x00e4, 0x00e5, 0x00e6, 0x00e7, 0x00e8, 0x00e9, 0x00ea, 0x00eb, 0x00ec, 0x00ed, 0x00ee, 0x00ef,
+  0x00f0, 0x00f1, 0x00f2, 0x00f3, 0x00f4, 0x00f5, 0x00f6, 0x00f7, 0x00f8, 0x00f9, 0x00fa, 0x00fb, 0x00fc, 0x00fd, 0x00fe, 0x00ff};
+
+static const uint16_t esp_mail_charset_windows_1250[128] PROGMEM = {
+  0x20ac, 0xfffd, 0x201a, 0xfffd, 0x201e, 0x2026, 0x2020, 0x2021, 0xfffd, 0x2030, 0x0160, 0x2039, 0x015a, 0x0164, 0x017d, 0x0179,
+  0xfffd, 0x2018, 0x2019, 0x201c, 0x201d, 0x2022, 0x2013, 0x2014, 0xfffd, 0x2122, 0x0161, 0x203a, 0x015b, 0x0165, 0x017e, 0x017a,
+  0x00a0, 0x02c7, 0x02d8, 0x0141, 0x00a4, 0x0104, 0x00a6, 0x00a7, 0x00a8, 0x00a9, 0x015e, 0x00ab, 0x00ac, 0x00ad, 0x00ae, 0x017b,
+  0x00b0, 0x00b1, 0x02db, 0x0142, 0x00b4, 0x00b5, 0x00b6, 0x00b7, 0x00b8, 0x0105, 0x015f, 0x00bb, 0x013d, 0x02dd, 0x013e, 0x017c,
+  0x0154, 0x00c1, 0x00c2, 0x0102, 0x00c4, 0x0139, 0x0106, 0x00c7, 0x010c, 0x00c9, 0x0118, 0x00cb, 0x011a, 0x00cd, 0x00ce, 0x010e,
+  0x0110, 0x0143, 0x0147, 0x00d3, 0x00d4, 0x0150, 0x00d6, 0x00d7, 0x0158, 0x016e, 0x00da, 0x0170, 0x00dc, 0x00dd, 0x0162, 0x00df,
+  0x0155, 0x00e1, 0x00e2, 0x0103, 0x00e4, 0x013a, 0x0107, 0x00e7, 0x010d, 0x00e9, 0x0119, 0x00eb, 0x011b, 0x00ed, 0x00ee, 0x010f,
+  0x0111, 0x0144, 0x0148, 0x00f3, 0x00f4, 0x0151, 0x00f6, 0x00f7, 0x0159, 0x016f, 0x00fa, 0x0171, 0x00fc, 0x00fd, 0x0163, 0x02d9};
+
+static const uint16_t esp_mail_charset_windows_1251[128] PROGMEM = {
+  0x0402, 0x0403, 0x201a, 0x0453, 0x201e, 0x2026, 0x2020, 0x2021, 0x20ac, 0x2030, 0x0409, 0x2039, 0x040a, 0x040c, 0x040b, 0x040f,
+  0x0452, 0x2018, 0x2019, 0x201c, 0x201d, 0x2022, 0x2013, 0x2014, 0xfffd, 0x2122, 0x0459, 0x203a, 0x045a, 0x045c, 0x045b, 0x045f,
+  0x00a0, 0x040e, 0x045e, 0x0408, 0x00a4, 0x0490, 0x00a6, 0x00a7, 0x0401, 0x00a9, 0x0404, 0x00ab, 0x00ac, 0x00ad, 0x00ae, 0x0407,
+  0x00b0, 0x00b1, 0x0406, 0x0456, 0x0491, 0x00b5, 0x00b6, 0x00b7, 0x0451, 0x2116, 0x0454, 0x00bb, 0x0458, 0x0405, 0x0455, 0x0457,
+  0x0410, 0x0411, 0x0412, 0x0413, 0x0414, 0x0415, 0x0416, 0x0417, 0x0418, 0x0419, 0x041a, 0x041b, 0x041c, 0x041d, 0x041e, 0x041f,
+  0x0420, 0x0421, 0x0422, 0x0423, 0x0424, 0x0425, 0x0426, 0x0427, 0x0428, 0x0429, 0x042a, 0x042b, 0x042c, 0x042d, 0x042e, 0x042f,
+  0x0430, 0x0431, 0x0432, 0x0433, 0x0434, 0x0435, 0x0436, 0x0437, 0x0438, 0x0439, 0x043a, 0x043b, 0x043c, 0x043d, 0x043e, 0x043f,
+  0x0440, 0x0441, 0x0442, 0x0443, 0x0444, 0x0445, 0x0446, 0x0447, 0x0448, 0x0449, 0x044a, 0x044b, 0x044c, 0x044d, 0x044e, 0x044f};
+
+static const uint16_t esp_mail_charset_windows_1252[128] PROGMEM = {
+  0x20ac, 0xfffd, 0x201a, 0x0192, 0x201e, 0x2026, 0x2020, 0x2021, 0x02c6, 0x2030, 0x0160, 0x2039, 0x0152, 0xfffd, 0x017d, 0xfffd,
+  0xfffd, 0x2018, 0x2019, 0x201c, 0x201d, 0x2022, 0x2013, 0x2014, 0x02dc, 0x2122, 0x0161, 0x203a, 0x0153, 0xfffd, 0x017e, 0x0178,
+  0x00a0, 0x00a1, 0x00a2, 0x00a3, 0x00a4, 0x00a5, 0x00a6, 0x00a7, 0x00a8, 0x00a9, 0x00aa, 0x00ab, 0x00ac, 0x00ad, 0x00ae, 0x00af,
+  0x00b0, 0x00b1, 0x00b2, 0x00b3, 0x00b4, 0x00b5, 0x00b6, 0x00b7, 0x00b8, 0x00b9, 0x00ba, 0x00bb, 0x00bc, 0x00bd, 0x00be, 0x00bf,
+  0x00c0, 0x00c1, 0x00c2, 0x00c3, 0x00c4, 0x00c5, 0x00c6, 0x00c7, 0x00c8, 0x00c9, 0x00ca, 0x00cb, 0x00cc, 0x00cd, 0x00ce, 0x00cf,
+  0x00d0, 0x00d1, 0x00d2, 0x00d3, 0x00d4, 0x00d5, 0x00d6, 0x00d7, 0x00d8, 0x00d9, 0x00da, 0x00db, 0x00dc, 0x00dd, 0x00de, 0x00df,
+  0x00e0, 0x00e1, 0x00e2, 0x00e3, 0x00e4, 0x00e5, 0x00e6, 0x00e7, 0x00e8, 0x00e9, 0x00ea, 0x00eb, 0x00ec, 0x00ed, 0x00ee, 0x00ef,
+  0x00f0, 0x00f1, 0x00f2, 0x00f3, 0x00f4, 0x00f5, 0x00f6, 0x00f7, 0x00f8, 0x00f9, 0x00fa, 0x00fb, 0x00fc, 0x00fd, 0x00fe, 0x00ff};
+
+static const uint16_t esp_mail_charset_koi8_r[128] PROGMEM = {
+  0x2500, 0x2502, 0x250c, 0x2510, 0x2514, 0x2518, 0x251c, 0x2524, 0x252c, 0x2534, 0x253c, 0x2580, 0x2584, 0x2588, 0x258c, 0x2590,
+  0x2591, 0x2592, 0x2593, 0x2320, 0x25a0, 0x2219, 0x221a, 0x2248, 0x2264, 0x2265, 0x00a0, 0x2321, 0x00b0, 0x00b2, 0x00b7, 0x00f7,
+  0x2550, 0x2551, 0x2552, 0x0451, 0x2553, 0x2554, 0x2555, 0x2556, 0x2557, 0x2558, 0x2559, 0x255a, 0x255b, 0x255c, 0x255d, 0x255e,
+  0x255f, 0x2560, 0x2561, 0x0401, 0x2562, 0x2563, 0x2564, 0x2565, 0x2566, 0x2567, 0x2568, 0x2569, 0x256a, 0x256b, 0x256c, 0x00a9,
+  0x044e, 0x0430, 0x0431, 0x0446, 0x0434, 0x0435, 0x0444, 0x0433, 0x0445, 0x0438, 0x0439, 0x043a, 0x043b, 0x043c, 0x043d, 0x043e,
+  0x043f, 0x044f, 0x0440, 0x0441, 0x0442, 0x0443, 0x0436, 0x0432, 0x044c, 0x044b, 0x0437, 0x0448, 0x044d, 0x0449, 0x0447, 0x044a,
+  0x042e, 0x0410, 0x0411, 0x0426, 0x0414, 0x0415, 0x0424, 0x0413, 0x0425, 0x0418, 0x0419, 0x041a, 0x041b, 0x041c, 0x041d, 0x041e,
+  0x041f, 0x042f, 0x0420, 0x0421, 0x0422, 0x0423, 0x0416, 0x0412, 0x042c, 0x042b, 0x0417, 0x0428, 0x042d, 0x0429, 0x0427, 0x042a};
+
+static const uint16_t esp_mail_charset_tis620[128] PROGMEM = {
+  0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+  0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+  0x00a0, 0x0e01, 0x0e02, 0x0e03, 0x0e04, 0x0e05, 0x0e06, 0x0e07, 0x0e08, 0x0e09, 0x0e0a, 0x0e0b, 0x0e0c, 0x0e0d, 0x0e0e, 0x0e0f,
+  0x0e10, 0x0e11, 0x0e12, 0x0e13, 0x0e14, 0x0e15, 0x0e16, 0x0e17, 0x0e18, 0x0e19, 0x0e1a, 0x0e1b, 0x0e1c, 0x0e1d, 0x0e1e, 0x0e1f,
+  0x0e20, 0x0e21, 0x0e22, 0x0e23, 0x0e24, 0x0e25, 0x0e26, 0x0e27, 0x0e28, 0x0e29, 0x0e2a, 0x0e2b, 0x0e2c, 0x0e2d, 0x0e2e, 0x0e2f,
+  0x0e30, 0x0e31, 0x0e32, 0x0e33, 0x0e34, 0x0e35, 0x0e36, 0x0e37, 0x0e38, 0x0e39, 0x0e3a, 0x0000, 0x0000, 0x0000, 0x0000, 0x0e3f,
+  0x0e40, 0x0e41, 0x0e42, 0x0e43, 0x0e44, 0x0e45, 0x0e46, 0x0e47, 0x0e48, 0x0e49, 0x0e4a, 0x0e4b, 0x0e4c, 0x0e4d, 0x0e4e, 0x0e4f,
+  0x0e50, 0x0e51, 0x0e52, 0x0e53, 0x0e54, 0x0e55, 0x0e56, 0x0e57, 0x0e58, 0x0e59, 0x0e5a, 0x0e5b, 0x0000, 0x0000, 0x0000, 0x0000};
+
+static const struct esp_mail_charset_t esp_mail_charsets[] = {
+  {esp_mail_str_227, esp_mail_char_decoding_scheme_iso8859_1, nullptr},
+  {esp_mail_str_237, esp_mail_char_decoding_scheme_tis620, esp_mail_charset_tis620},
+  {esp_mail_str_231, esp_mail_char_decoding_scheme_tis620, esp_mail_charset_tis620},
+  {esp_mail_str_226, esp_mail_char_decoding_scheme_tis620, esp_mail_charset_tis620},
+  {esp_mail_str_351, esp_mail_char_decoding_scheme_iso8859_2, esp_mail_charset_iso8859_2},
+  {esp_mail_str_352, esp_mail_char_decoding_scheme_iso8859_5, esp_mail_charset_iso8859_5},
+  {esp_mail_str_353, esp_mail_char_decoding_scheme_iso8859_15, esp_mail_charset_iso8859_15},
+  {esp_mail_str_354, esp_mail_char_decoding_scheme_windows_1250, esp_mail_charset_windows_1250},
+  {esp_mail_str_355, esp_mail_char_decoding_scheme_windows_1251, esp_mail_charset_windows_1251},
+  {esp_mail_str_356, esp_mail_char_decoding_scheme_windows_1252, esp_mail_charset_windows_1252},
+  {esp_mail_str_357, esp_mail_char_decoding_scheme_koi8_r, esp_mail_charset_koi8_r}};
+
 #endif
 
 #if defined(ENABLE_SMTP) || defined(ENABLE_IMAP)
@@ -1835,6 +2328,43 @@ static const char esp_mail_str_314[] PROGMEM = "> C: ESP Mail Client v";
 static const char esp_mail_str_328[] PROGMEM = "0.0.0.0";
 static const char esp_mail_str_329[] PROGMEM = ", Fw v";
 static const char esp_mail_str_330[] PROGMEM = "+";
+static const char esp_mail_str_343[] PROGMEM = "> C: memory usage, alloc ";
+static const char esp_mail_str_344[] PROGMEM = ", free ";
+static const char esp_mail_str_345[] PROGMEM = ", bytes ";
+static const char esp_mail_str_346[] PROGMEM = ", peak ";
+static const char esp_mail_str_347[] PROGMEM = ", flash string ";
+static const char esp_mail_str_348[] PROGMEM = ", integer ";
+static const char esp_mail_str_349[] PROGMEM = ", substring ";
+static const char esp_mail_str_350[] PROGMEM = ", buffer ";
+
+#endif
+
+#if defined(ENABLE_IMAP)
+
+/* The header field names, indexed by esp_mail_header_field - 1 */
+static PGM_P const esp_mail_header_field_names[] = {
+  esp_mail_str_10,
+  esp_mail_str_150,
+  esp_mail_str_11,
+  esp_mail_str_12,
+  esp_mail_str_24,
+  esp_mail_str_46,
+  esp_mail_str_184,
+  esp_mail_str_109,
+  esp_mail_str_107,
+  esp_mail_str_134,
+  esp_mail_str_145,
+  esp_mail_str_25,
+  esp_mail_str_172,
+  esp_mail_str_190,
+  esp_mail_str_191,
+  esp_mail_str_99,
+  esp_mail_str_101,
+  esp_mail_str_174,
+  esp_mail_str_175};
+
+/* The header fields by their name hash, the perfect hash of the names above */
+static const uint8_t esp_mail_header_field_slots[32] PROGMEM = {0, 0, 19, 0, 0, 3, 5, 7, 16, 0, 1, 14, 11, 0, 6, 0, 8, 13, 9, 15, 17, 0, 4, 0, 0, 2, 0, 0, 12, 10, 0, 18};
 
 #endif
 
@@ -1843,6 +2373,25 @@ static const char esp_mail_str_330[] PROGMEM = "+";
 
 static const unsigned char b64_index_table[65] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
 
+//the sextet of each base64 character, 0x40 for the padding and 0x80 for the characters to be skipped
+static const unsigned char b64_decode_table[256] = {
+  0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+  0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+  0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x3e, 0x80, 0x80, 0x80, 0x3f,
+  0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x3b, 0x3c, 0x3d, 0x80, 0x80, 0x80, 0x40, 0x80, 0x80,
+  0x80, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e,
+  0x0f, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0x80, 0x80, 0x80, 0x80, 0x80,
+  0x80, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f, 0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0x28,
+  0x29, 0x2a, 0x2b, 0x2c, 0x2d, 0x2e, 0x2f, 0x30, 0x31, 0x32, 0x33, 0x80, 0x80, 0x80, 0x80, 0x80,
+  0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+  0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+  0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+  0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+  0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+  0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+  0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+  0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80};
+
 __attribute__((used)) static bool compFunc(uint32_t i, uint32_t j)
 {
   return (i > j);
@@ -2024,8 +2573,13 @@ class SMTP_Message
 {
 public:
   SMTP_Message(){};
+  SMTP_Message(const SMTP_Message &) = default;
+  SMTP_Message(SMTP_Message &&) = default;
   ~SMTP_Message() { clear(); };
 
+  SMTP_Message &operator=(const SMTP_Message &) = default;
+  SMTP_Message &operator=(SMTP_Message &&) = default;
+
   void resetAttachItem(SMTP_Attachment &att)
   {
     att.blob.size = 0;
@@ -2437,6 +2991,15 @@ public:
   */
   int getFreeHeap();
 
+#if defined(ENABLE_ALLOC_STATS) && (defined(ENABLE_SMTP) || defined(ENABLE_IMAP))
+  /** Get the internal buffer allocation statistics of the last operation
+   * e.g. sendMail, readMail, setFlag, connect and listen.
+   *
+   * @return The esp_mail_alloc_stats_t data.
+  */
+  esp_mail_alloc_stats_t allocStats();
+#endif
+
   ESPTimeHelper Time;
 
 private:
@@ -2465,6 +3028,14 @@ private:
   unsigned long _lastReconnectMillis = 0;
   uint16_t _reconnectTimeout = ESP_MAIL_WIFI_RECONNECT_TIMEOUT;
 
+#if defined(ENABLE_ALLOC_STATS)
+  esp_mail_alloc_stats_t _allocStats;
+  esp_mail_alloc_stats_t _lastAllocStats;
+  int _allocStatsLevel = 0;
+#endif
+
+  struct esp_mail_arena_t _arena;
+
   char *strReplace(char *orig, char *rep, char *with);
   char *strReplaceP(char *buf, PGM_P key, PGM_P value);
   bool authFailed(char *buf, int bufLen, int &chunkIdx, int ofs);
@@ -2483,28 +3054,45 @@ private:
   char *getRandomUID();
   void splitTk(MBSTRING &str, std::vector<MBSTRING> &tk, const char *delim);
   unsigned char *decodeBase64(const unsigned char *src, size_t len, size_t *out_len);
+  size_t decodeBase64Chunk(struct esp_mail_base64_decoder_t &decoder, const unsigned char *src, size_t len, unsigned char *out);
+  size_t decodeBase64End(struct esp_mail_base64_decoder_t &decoder, unsigned char *out);
   MBSTRING encodeBase64Str(const unsigned char *src, size_t len);
   MBSTRING encodeBase64Str(uint8_t *src, size_t len);
-  int readLine(WiFiClient *stream, char *buf, int bufLen, bool crlf, int &count);
+  size_t encodeBase64Lines(const unsigned char *src, size_t len, unsigned char *out, int &col, bool last, int lineLen = BASE64_CHUNKED_LEN);
+  bool fillReader(WiFiClient *stream, struct esp_mail_line_reader_t &reader);
+  void clearReader(struct esp_mail_line_reader_t &reader);
+  int readerAvailable(WiFiClient *stream, struct esp_mail_line_reader_t &reader);
+  int readByte(WiFiClient *stream, struct esp_mail_line_reader_t &reader);
+  int readBytes(WiFiClient *stream, struct esp_mail_line_reader_t &reader, char *buf, int len);
+  int readLine(WiFiClient *stream, struct esp_mail_line_reader_t &reader, char *buf, int bufLen, bool crlf, int &count);
   char *subStr(const char *buf, PGM_P beginH, PGM_P endH, int beginPos, int endPos = 0, bool caseSensitive = true);
   void strcat_c(char *str, char c);
   int strpos(const char *haystack, const char *needle, int offset, bool caseSensitive = true);
-  void *newP(size_t len);
+  void *newP(size_t len, esp_mail_alloc_type type = esp_mail_alloc_type_buffer);
   void delP(void *ptr);
+  void *arenaNewP(size_t len);
+  bool arenaDelP(void *ptr);
+  void beginAllocStats();
+  void endAllocStats(bool debug);
+#if defined(ENABLE_ALLOC_STATS)
+  void countAlloc(size_t size, esp_mail_alloc_type type);
+  void countFree(size_t size);
+#endif
   char *newS(char *p, size_t len);
   char *newS(char *p, size_t len, char *d);
   bool strcmpP(const char *buf, int ofs, PGM_P beginH, bool caseSensitive = true);
   int strposP(const char *buf, PGM_P beginH, int ofs, bool caseSensitive = true);
   char *strP(PGM_P pgm);
   void appendP(MBSTRING &buf, PGM_P p, bool empty);
-  char *intStr(int value);
+  size_t intToStr(int value, char *buf);
+  void appendInt(MBSTRING &buf, int value);
 
 #endif
 
 #if defined(ENABLE_SMTP)
-  void encodeQP(const char *buf, char *out);
-  void formatFlowedText(MBSTRING &content);
-  void softBreak(MBSTRING &content, const char *quoteMarks);
+  size_t encodeQP(struct esp_mail_qp_encoder_t &encoder, const char *src, size_t len, char *out, size_t outLen, size_t &olen);
+  void formatFlowedText(const char *content, MBSTRING &out);
+  void replaceInlineCID(SMTP_Message *msg, const char *html, MBSTRING &out);
   void getMIME(const char *ext, MBSTRING &mime);
   void mimeFromFile(const char *name, MBSTRING &mime);
   MBSTRING getBoundary(size_t len);
@@ -2517,6 +3105,8 @@ private:
   size_t smtpSend(SMTPSession *smtp, int data, bool newline = false);
   size_t smtpSend(SMTPSession *smtp, uint8_t *data, size_t size);
   bool handleSMTPError(SMTPSession *smtp, int err, bool ret = false);
+  void smtpPhase(SMTPSession *smtp, int phase);
+  void clearSMTPPhases(SMTPSession *smtp, int first, int last);
   bool sendParallelAttachments(SMTPSession *smtp, SMTP_Message *msg, const MBSTRING &boundary);
   bool sendAttachments(SMTPSession *smtp, SMTP_Message *msg, const MBSTRING &boundary, bool parallel = false);
   bool sendMSGData(SMTPSession *smtp, SMTP_Message *msg, bool closeSession, bool rfc822MSG);
@@ -2538,7 +3128,8 @@ private:
   void getInlineHeader(MBSTRING &header, const MBSTRING &boundary, SMTP_Attachment *inlineAttach, size_t size);
   bool sendBlobBody(SMTPSession *smtp, SMTP_Message *msg, uint8_t type);
   bool sendFileBody(SMTPSession *smtp, SMTP_Message *msg, uint8_t type);
-  void encodingText(SMTPSession *smtp, SMTP_Message *msg, uint8_t type, MBSTRING &content);
+  bool encodingText(SMTPSession *smtp, SMTP_Message *msg, uint8_t type, MBSTRING &content);
+  bool sendQP(SMTPSession *smtp, SMTP_Message *msg, MBSTRING &content, const char *src, size_t len);
   bool sendBase64(SMTPSession *smtp, SMTP_Message *msg, const unsigned char *data, size_t len, bool flashMem, const char *filename, bool report);
   bool sendBase64Raw(SMTPSession *smtp, SMTP_Message *msg, const uint8_t *data, size_t len, bool flashMem, const char *filename, bool report);
   bool sendBase64Stream(SMTPSession *smtp, SMTP_Message *msg, File file, const char *filename, bool report);
@@ -2558,16 +3149,19 @@ private:
 
 #if defined(ENABLE_IMAP)
 
-  RFC2047_Decoder RFC2047Decoder;
-
   bool multipartMember(const MBSTRING &part, const MBSTRING &check);
-  int decodeChar(const char *s);
-  void decodeQP(const char *buf, char *out);
+  int hexDigit(char c);
+  size_t decodeQP(struct esp_mail_qp_decoder_t &decoder, const char *src, size_t len, char *out);
   char *decode7Bit(char *buf);
-  esp_mail_char_decoding_scheme getEncodingFromCharset(const char *enc);
+  const struct esp_mail_charset_t *getCharset(const char *enc);
+  esp_mail_header_field getHeaderField(const char *buf, size_t &valueOfs);
   void decodeHeader(MBSTRING &headerField);
-  int decodeLatin1_UTF8(unsigned char *out, int *outlen, const unsigned char *in, int *inlen);
-  void decodeTIS620_UTF8(char *out, const char *in, size_t len);
+  void decodeHeaderFields(struct esp_mail_imap_rfc822_msg_header_item_t &fields);
+  const char *internStr(IMAPSession *imap, const char *str);
+  void clearInternStr(IMAPSession *imap);
+  void decodeHeaderWord(MBSTRING &out, const char *charsetName, char enc, const char *text, size_t len);
+  void appendHeaderText(MBSTRING &out, const struct esp_mail_charset_t *charset, bool filter, char *text, size_t len);
+  size_t decodeCharset(const struct esp_mail_charset_t *charset, const char *src, size_t len, char *out);
   bool reconnect(IMAPSession *imap, unsigned long dataTime = 0, bool downloadRequestuest = false);
   void closeTCPSession(IMAPSession *imap);
   bool getMultipartFechCmd(IMAPSession *imap, int msgIdx, MBSTRING &partText);
@@ -2592,6 +3186,7 @@ private:
   struct esp_mail_message_header_t *cHeader(IMAPSession *imap);
   int available(IMAPSession *imap);
   bool handleIMAPResponse(IMAPSession *imap, int errCode, bool closeSession);
+  bool mHandleIMAPResponse(IMAPSession *imap, int errCode, bool closeSession);
   void downloadReport(IMAPSession *imap, int progress);
   void fetchReport(IMAPSession *imap, int progress, bool html);
   void searchReport(int progress, const char *percent);
@@ -2601,6 +3196,8 @@ private:
   void saveHeader(IMAPSession *imap);
   void prepareFilePath(IMAPSession *imap, MBSTRING &filePath, bool header);
   void decodeText(IMAPSession *imap, char *buf, int bufLen, int &chunkIdx, File &file, MBSTRING &filePath, bool &downloadRequest, int &octetLength, int &readDataLen, int &readCount);
+  void handleDecodedText(IMAPSession *imap, char *decoded, size_t olen, bool newC, File &file, MBSTRING &filePath, bool &downloadRequest, int &octetLength, int &readDataLen, int &readCount);
+  void storeDecodedText(IMAPSession *imap, const char *text, size_t len, bool keep, File &file, MBSTRING &filePath, bool &downloadRequest);
   bool handleAttachment(IMAPSession *imap, char *buf, int bufLen, int &chunkIdx, File &file, MBSTRING &filePath, bool &downloadRequest, int &octetCount, int &octetLength, int &oCount, int &reportState, int &downloadCount);
   void handleFolders(IMAPSession *imap, char *buf);
   void handleCapability(IMAPSession *imap, char *buf, int &chunkIdx);
@@ -2609,6 +3206,7 @@ private:
   void handleGetFlags(IMAPSession *imap, char *buf);
   void handleExamine(IMAPSession *imap, char *buf);
   bool handleIMAPError(IMAPSession *imap, int err, bool ret);
+  bool mReadMail(IMAPSession *imap, bool closeSession = true);
   bool mSetFlag(IMAPSession *imap, int msgUID, const char *flags, uint8_t action, bool closeSession);
 #endif
 };
@@ -2753,7 +3351,7 @@ public:
   /** Listen for the selected or open mailbox for updates.
    * @return The boolean value which indicates the success of operation.
   */
-  bool listen() { return mListen(false); };
+  bool listen();
 
   /** Stop listen for the mailbox for updates.
    * @return The boolean value which indicates the success of operation.
@@ -2805,6 +3403,18 @@ public:
   */
   void empty();
 
+  /** Get the response statistics of the IMAP command.
+   *
+   * @param cmd The esp_mail_imap_command e.g. esp_mail_imap_cmd_fetch_body_text.
+   * @return The IMAP_Command_Stats structured data which contains the count,
+   * bytes read and written, total time and the latency histogram.
+  */
+  IMAP_Command_Stats commandStats(esp_mail_imap_command cmd);
+
+  /** Clear the response statistics of all IMAP commands.
+  */
+  void resetCommandStats();
+
   friend class ESP_Mail_Client;
   friend class foldderList;
 
@@ -2829,6 +3439,18 @@ private:
   int _totalRead = 0;
   std::vector<struct esp_mail_message_header_t> _headers = std::vector<struct esp_mail_message_header_t>();
 
+  //the repeated header values e.g. charset, transfer encoding, content type and flags, shared by all headers
+  std::vector<char *> _internStr = std::vector<char *>();
+
+  struct esp_mail_imap_command_stats_t _cmdStats[esp_mail_imap_cmd_max];
+  size_t _sentBytes = 0;
+  size_t _statSentBytes = 0;
+  size_t _readBytes = 0;
+  struct esp_mail_line_reader_t _reader;
+  struct esp_mail_base64_decoder_t _b64Decoder;
+  struct esp_mail_qp_decoder_t _qpDecoder;
+  const struct esp_mail_charset_t *_charset = nullptr;
+
   esp_mail_imap_command _imap_cmd = esp_mail_imap_command::esp_mail_imap_cmd_login;
   std::vector<struct esp_mail_imap_multipart_level_t> _multipart_levels = std::vector<struct esp_mail_imap_multipart_level_t>();
   int _rfc822_part_count = 0;
@@ -2965,6 +3587,13 @@ private:
   bool _chunkedEnable = false;
   int _chunkCount = 0;
 
+  struct esp_mail_smtp_phase_info_t _phases[esp_mail_smtp_phase_max];
+  int _phase = esp_mail_smtp_phase_max;
+  unsigned long _phaseMillis = 0;
+  size_t _phaseBytes = 0;
+  size_t _sentBytes = 0;
+  struct esp_mail_line_reader_t _reader;
+
   esp_mail_smtp_command _smtp_cmd = esp_mail_smtp_command::esp_mail_smtp_cmd_greeting;
   struct esp_mail_auth_capability_t _auth_capability;
   struct esp_mail_smtp_capability_t _send_capability;
@@ -56,4 +56,19 @@
 //Enable SMTP class
 #define ENABLE_SMTP //comment this line to disable or exclude it
 
+//Enable the allocation statistics of the internal buffers
+//#define ENABLE_ALLOC_STATS //uncomment this line to enable
+
+//The number of bytes read from the attachment file at once, use a multiple of the SD card sector size (512)
+//#define ESP_MAIL_FILE_READ_BLOCK_SIZE 4096 //uncomment this line to change the default size
+
+//The size of the static buffer which holds the short-lived strings of the response parsers
+//#define ESP_MAIL_ARENA_SIZE 2048 //uncomment this line to change the default size
+
+//The extra capacity in percent added when the string buffer grows, a smaller value uses less memory but copies more often
+//#define MB_STRING_GROWTH_PERCENT 50 //uncomment this line to change the default growth
+
+//The size of the inline buffer which holds the short string without heap allocation
+//#define MB_STRING_SSO_SIZE 16 //uncomment this line to change the default size
+
 #endif
\ No newline at end of file
@@ -34,6 +34,24 @@
 #include <string>
 #include <strings.h>
 
+//the capacity added when the buffer grows, in percent of the required length
+#if !defined(MB_STRING_GROWTH_PERCENT)
+#if defined(ESP8266)
+#define MB_STRING_GROWTH_PERCENT 25
+#else
+#define MB_STRING_GROWTH_PERCENT 50
+#endif
+#endif
+
+//the size of the inline buffer which holds the short string without heap allocation
+#if !defined(MB_STRING_SSO_SIZE)
+#if defined(ESP8266)
+#define MB_STRING_SSO_SIZE 8
+#else
+#define MB_STRING_SSO_SIZE 16
+#endif
+#endif
+
 class MB_String
 {
 public:
@@ -56,6 +74,11 @@ public:
         *this = value;
     }
 
+    MB_String(MB_String &&value) noexcept
+    {
+        take(value);
+    }
+
     MB_String &operator=(const std::string &rhs)
     {
         if (rhs.length() > 0)
@@ -119,6 +142,17 @@ public:
         return *this;
     }
 
+    MB_String &operator=(MB_String &&rhs) noexcept
+    {
+        if (this != &rhs)
+        {
+            clear();
+            take(rhs);
+        }
+
+        return *this;
+    }
+
     MB_String &operator+=(const MB_String &rhs)
     {
         concat(rhs);
@@ -127,15 +161,7 @@ public:
 
     MB_String &operator+=(const char *cstr)
     {
-        size_t len = strlen(cstr);
-        size_t slen = length();
-
-        if (_reserve(slen + len, false))
-        {
-            strcat(buf, cstr);
-            *(buf + slen + len) = '\0';
-        }
-
+        concat(cstr);
         return (*this);
     }
 
@@ -174,8 +200,10 @@ public:
 
         size_t slen = length();
 
-        if (n > strlen(cstr))
-            n = strlen(cstr);
+        //stop at the nul terminator without reading past n
+        const char *z = (const char *)memchr(cstr, 0, n);
+        if (z)
+            n = z - cstr;
 
         if (_reserve(slen + n, false))
         {
@@ -658,7 +686,7 @@ private:
 
         size_t slen = length();
 
-        if (slen + len > maxLength())
+        if (!buf || slen + len > maxLength())
         {
             if (!_reserve(slen + len, false))
                 return;
@@ -680,7 +708,7 @@ private:
     {
         if (len == 0)
         {
-            if (buf)
+            if (buf && buf != sso)
                 free(buf);
             buf = NULL;
             bufLen = 0;
@@ -689,38 +717,74 @@ private:
 
         if (len > bufLen || shrink)
         {
+            size_t slen = length();
+            if (slen >= len)
+                slen = len - 1;
 
-            if (shrink || (bufLen > 0 && buf))
+            if (len <= sizeof(sso))
             {
-                int slen = length();
+                //the short string is moved to the inline buffer
+                if (buf != sso)
+                {
+                    if (buf)
+                    {
+                        memcpy(sso, buf, slen);
+                        free(buf);
+                    }
+                    buf = sso;
+                }
+                buf[slen] = '\0';
+                bufLen = sizeof(sso);
+                return;
+            }
 
+            char *p = NULL;
+
+            if (buf && buf != sso)
+            {
 #if defined(BOARD_HAS_PSRAM) && defined(MB_STRING_USE_PSRAM)
 
-                buf = (char *)ps_realloc(buf, len);
+                p = (char *)ps_realloc(buf, len);
 #else
-                buf = (char *)realloc(buf, len);
+                p = (char *)realloc(buf, len);
 #endif
-
-                if (!buf)
-                    return;
-                buf[slen] = '\0';
-                bufLen = len;
             }
             else
             {
 #if defined(BOARD_HAS_PSRAM) && defined(MB_STRING_USE_PSRAM)
-                if ((buf = (char *)ps_malloc(len)) == 0)
-                    return;
+                p = (char *)ps_malloc(len);
 #else
-                if ((buf = (char *)malloc(len)) == 0)
-                    return;
+                p = (char *)malloc(len);
 #endif
-                buf[0] = '\0';
-                bufLen = len;
+                if (p && buf)
+                    memcpy(p, buf, slen);
             }
+
+            if (!p)
+                return;
+
+            buf = p;
+            buf[slen] = '\0';
+            bufLen = len;
         }
     }
 
+    void take(MB_String &rhs)
+    {
+        //the inline buffer is copied, the heap buffer is taken over
+        if (rhs.buf == rhs.sso)
+        {
+            memcpy(sso, rhs.sso, sizeof(sso));
+            buf = sso;
+        }
+        else
+            buf = rhs.buf;
+
+        bufLen = rhs.bufLen;
+        rhs.buf = NULL;
+        rhs.bufLen = 0;
+    }
+
     MB_String &copy(const char *cstr, size_t length)
     {
         clear();
@@ -739,14 +803,16 @@ private:
 
     bool _reserve(size_t len, bool shrink)
     {
-
-        size_t newlen = getReservedLen(len);
         if (shrink)
-            allocate(newlen, true);
-        else if (newlen > bufLen)
-            allocate(newlen, false);
+            allocate(getReservedLen(len), true);
+        else if (len + 1 > bufLen)
+        {
+            //grow geometrically so that the repeated appends are amortized
+            size_t growth = bufLen > 0 ? len + len * MB_STRING_GROWTH_PERCENT / 100 : len;
+            allocate(getReservedLen(growth), false);
+        }
 
-        return newlen <= bufLen;
+        return len + 1 <= bufLen;
     }
 
     int strpos(const char *haystack, const char *needle, int offset) const
@@ -892,6 +958,7 @@ private:
 
     char *buf = NULL;
     size_t bufLen = 0;
+    char sso[MB_STRING_SSO_SIZE];
 };
 
 inline MB_String operator+(const MB_String &lhs, const MB_String &rhs)
@@ -911,26 +978,30 @@ inline MB_String operator+(MB_String &&lhs, const MB_String &rhs)
 
 inline MB_String operator+(MB_String &lhs, MB_String &&rhs)
 {
-    lhs += rhs;
-    return std::move(lhs);
+    MB_String res(lhs);
+    res += rhs;
+    return res;
 }
 
-inline MB_String operator+(MB_String &lhs, char rhs)
+inline MB_String operator+(const MB_String &lhs, char rhs)
 {
-    lhs += rhs;
-    return std::move(lhs);
+    MB_String res(lhs);
+    res += rhs;
+    return res;
 }
 
-inline MB_String operator+(char lhs, MB_String &rhs)
+inline MB_String operator+(char lhs, const MB_String &rhs)
 {
-    rhs.insert(0, lhs);
-    return rhs;
+    MB_String res;
+    res += lhs;
+    res += rhs;
+    return res;
 }
 
 inline MB_String operator+(MB_String &&lhs, char rhs)
 {
-    Serial.println(rhs);
-    return std::move(lhs.insert(0, rhs));
+    lhs += rhs;
+    return std::move(lhs);
 }
 
 #endif
\ No newline at end of file